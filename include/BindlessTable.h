@@ -0,0 +1,99 @@
+#pragma once
+#include "Types.h"
+
+#include <array>
+#include <vector>
+
+enum class BindlessBinding : uint32_t
+{
+    SampledImage = 0,
+    Sampler = 1,
+    StorageImage = 2,
+    StorageBuffer = 3,
+};
+
+// One global descriptor set of runtime arrays that every bindless shader sees at set 0: sampled images, samplers,
+// storage images and storage buffers at bindings 0 to 3. Resources are registered once and referenced by their
+// array index, usually through a push constant, so nothing is allocated or bound per draw.
+//
+// With VK_EXT_descriptor_buffer the descriptors live in a host-visible descriptor buffer written with
+// vkGetDescriptorEXT. Otherwise the set comes from an update-after-bind pool and is written with
+// vkUpdateDescriptorSets. Indices are only reused after remove(), which callers defer until no frame in flight can
+// still read the old descriptor. Call from the render thread only.
+class BindlessTable
+{
+public:
+    static constexpr uint32_t MAX_SAMPLED_IMAGES = 4096;
+    static constexpr uint32_t MAX_SAMPLERS = 64;
+    static constexpr uint32_t MAX_STORAGE_IMAGES = 256;
+    static constexpr uint32_t MAX_STORAGE_BUFFERS = 4096;
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+    // `use_descriptor_buffer` requires the descriptorBuffer feature to be enabled on `device`
+    void init(VkDevice device, VkPhysicalDevice physical_device, VmaAllocator allocator, bool use_descriptor_buffer);
+    void destroy();
+
+    uint32_t add_sampled_image(VkImageView view, VkImageLayout layout);
+    uint32_t add_sampler(VkSampler sampler);
+    uint32_t add_storage_image(VkImageView view);
+    uint32_t add_storage_buffer(VkBuffer buffer, VkDeviceAddress address, VkDeviceSize size);
+    void remove(BindlessBinding binding, uint32_t index);
+
+    // Bind the table as set 0 of `layout`, which has to be created from get_layout()
+    void bind(VkCommandBuffer cmd, VkPipelineBindPoint bind_point, VkPipelineLayout layout) const;
+
+    VkDescriptorSetLayout get_layout() const
+    {
+        return m_layout;
+    }
+    // Pipelines using the layout need these flags, which are set with descriptor buffers
+    VkPipelineCreateFlags get_pipeline_create_flags() const
+    {
+        return m_use_descriptor_buffer ? VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT : 0;
+    }
+    bool uses_descriptor_buffer() const
+    {
+        return m_use_descriptor_buffer;
+    }
+    uint32_t get_used_count(BindlessBinding binding) const;
+
+private:
+    static constexpr uint32_t BINDING_COUNT = 4;
+
+    struct Slots
+    {
+        uint32_t capacity = 0;
+        uint32_t next = 0;
+        std::vector<uint32_t> free;
+        // Descriptor buffer only: where the binding starts and how large one descriptor is
+        VkDeviceSize offset = 0;
+        size_t descriptor_size = 0;
+    };
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+    bool m_use_descriptor_buffer = false;
+    VkDescriptorSetLayout m_layout = VK_NULL_HANDLE;
+    std::array<Slots, BINDING_COUNT> m_slots;
+
+    // Descriptor indexing fallback
+    VkDescriptorPool m_pool = VK_NULL_HANDLE;
+    VkDescriptorSet m_set = VK_NULL_HANDLE;
+
+    // Descriptor buffer
+    AllocatedBuffer m_buffer = {};
+    VkDeviceAddress m_buffer_address = 0;
+    PFN_vkGetDescriptorSetLayoutSizeEXT m_get_layout_size = nullptr;
+    PFN_vkGetDescriptorSetLayoutBindingOffsetEXT m_get_binding_offset = nullptr;
+    PFN_vkGetDescriptorEXT m_get_descriptor = nullptr;
+    PFN_vkCmdBindDescriptorBuffersEXT m_cmd_bind_descriptor_buffers = nullptr;
+    PFN_vkCmdSetDescriptorBufferOffsetsEXT m_cmd_set_descriptor_buffer_offsets = nullptr;
+
+    uint32_t allocate_index(BindlessBinding binding);
+    // Write one descriptor through whichever path is active. Exactly one of the pointers is set.
+    void write(BindlessBinding binding,
+               uint32_t index,
+               const VkDescriptorImageInfo* image_info,
+               const VkDescriptorBufferInfo* buffer_info,
+               VkDeviceAddress buffer_address);
+};
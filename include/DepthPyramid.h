@@ -0,0 +1,92 @@
+#pragma once
+#include "Types.h"
+#include "PipelineCompiler.h"
+#include "DescriptorAllocator.h"
+
+#include <array>
+
+// Hierarchical-Z pyramid of a reversed-Z depth buffer. Every texel holds the farthest depth under it, so a bounding
+// rectangle that is nearer than none of its texels is fully hidden. The base level is the largest power of two that
+// fits in the depth image.
+class DepthPyramid
+{
+public:
+    static constexpr uint32_t MAX_MIP_COUNT = 16;
+
+    void init(VkDevice device, VmaAllocator allocator, PipelineCompiler& pipeline_compiler);
+    void destroy();
+
+    // (Re)create the pyramid for a depth image. The contents start out invalid.
+    void create(VkImageView depth_view, VkExtent2D depth_extent);
+    void destroy_image();
+    // Follow a resized depth image without waiting for the GPU. The current image is kept when the depth view and the
+    // pyramid size stay the same, otherwise it goes to `deletion_queue` and a new one is created.
+    void resize(VkImageView depth_view, VkExtent2D depth_extent, TimelineDeletionQueue& deletion_queue);
+
+    // False while the reduce pipeline is still compiling
+    bool is_ready();
+    // Reduce the depth image, which must be in DEPTH_READ_ONLY_OPTIMAL, into every level of the pyramid, which must be
+    // in GENERAL. Only the barriers between levels are recorded here; the caller synchronizes the pyramid as a whole.
+    // The reduce sets come from `descriptor_allocator`, which must outlive the command buffer's execution.
+    bool build(VkCommandBuffer cmd, DescriptorAllocator& descriptor_allocator);
+
+    bool is_valid() const
+    {
+        return m_valid;
+    }
+    void invalidate()
+    {
+        m_valid = false;
+    }
+    VkImage get_image() const
+    {
+        return m_image;
+    }
+    VkExtent2D get_extent() const
+    {
+        return m_extent;
+    }
+    uint32_t get_mip_count() const
+    {
+        return m_mip_count;
+    }
+    // View of every level in GENERAL and the nearest-filtering sampler to read it with
+    VkImageView get_view() const
+    {
+        return m_view;
+    }
+    VkSampler get_sampler() const
+    {
+        return m_sampler;
+    }
+
+private:
+    struct ReducePushConstants
+    {
+        uint32_t source_width;
+        uint32_t source_height;
+        uint32_t destination_width;
+        uint32_t destination_height;
+    };
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+
+    VkSampler m_sampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_reduce_set_layout = VK_NULL_HANDLE;
+    VkPipelineLayout m_reduce_pipeline_layout = VK_NULL_HANDLE;
+    PipelineJob m_reduce_pipeline_job;
+    VkPipeline m_reduce_pipeline = VK_NULL_HANDLE;
+
+    VkImage m_image = VK_NULL_HANDLE;
+    VmaAllocation m_allocation = VK_NULL_HANDLE;
+    VkImageView m_depth_view = VK_NULL_HANDLE;
+    VkImageView m_view = VK_NULL_HANDLE;
+    std::array<VkImageView, MAX_MIP_COUNT> m_mip_views = {};
+    VkExtent2D m_extent = {};
+    VkExtent2D m_depth_extent = {};
+    uint32_t m_mip_count = 0;
+    bool m_valid = false;
+
+    static VkExtent2D pyramid_extent(VkExtent2D depth_extent);
+};
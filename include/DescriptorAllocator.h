@@ -0,0 +1,62 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Share of each descriptor type in a pool, per set the pool is sized for
+struct DescriptorPoolSizeRatio
+{
+    VkDescriptorType type;
+    float ratio;
+};
+
+// Hands out descriptor sets from a chain of pools. When the current pool runs out a new one is created, each 1.5x
+// larger than the last up to MAX_SETS_PER_POOL, so allocate() never fails for lack of pool space. Sets are never
+// freed one by one: reset() recycles every pool at once, which makes it a fit for per-frame transient sets that are
+// reset when their frame slot comes around again. Not thread safe.
+class DescriptorAllocator
+{
+public:
+    static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+    void init(VkDevice device, uint32_t initial_sets, std::span<const DescriptorPoolSizeRatio> ratios);
+    void destroy();
+
+    // Every set allocated so far becomes invalid, so only call this once the GPU is done with them
+    void reset();
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+    uint32_t get_pool_count() const
+    {
+        return static_cast<uint32_t>(m_ready_pools.size() + m_full_pools.size());
+    }
+    // Sets allocated since the last reset, and between the two resets before that
+    uint32_t get_set_count() const
+    {
+        return m_set_count;
+    }
+    uint32_t get_last_set_count() const
+    {
+        return m_last_set_count;
+    }
+    uint64_t get_total_set_count() const
+    {
+        return m_total_set_count;
+    }
+
+private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    std::vector<DescriptorPoolSizeRatio> m_ratios;
+    // The back of m_ready_pools is the one being allocated from
+    std::vector<VkDescriptorPool> m_ready_pools;
+    std::vector<VkDescriptorPool> m_full_pools;
+    uint32_t m_sets_per_pool = 0;
+    uint32_t m_set_count = 0;
+    uint32_t m_last_set_count = 0;
+    uint64_t m_total_set_count = 0;
+
+    VkDescriptorPool create_pool(uint32_t set_count) const;
+    VkDescriptorPool get_pool();
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include "vulkan/vulkan.h"
+#include <cstdint>
+
+// Picks the fraction of the output resolution to render at so the GPU frame time holds a budget. The scale drops as
+// soon as frames run over budget and only climbs back after a stretch of frames with clear headroom, so it doesn't
+// oscillate around the target.
+class DynamicResolution
+{
+public:
+    void set_target_ms(double target_ms)
+    {
+        m_target_ms = target_ms;
+    }
+    double get_target_ms() const
+    {
+        return m_target_ms;
+    }
+    void set_scale_range(float min_scale, float max_scale);
+    // GPU times arrive this many frames after the scale they were rendered at was picked
+    void set_latency(uint32_t frame_count)
+    {
+        m_latency_frames = frame_count;
+    }
+
+    // Feed the GPU time of the oldest frame not reported yet. Returns true when the scale changed.
+    bool update(double gpu_ms);
+    // Back to full scale, e.g. when the controller is switched off
+    void reset();
+
+    float get_scale() const
+    {
+        return m_scale;
+    }
+    // Scales both sides of the output extent, rounded to whole tiles and never above the output itself
+    VkExtent2D scale_extent(VkExtent2D extent) const;
+
+private:
+    // Over this fraction of the budget the scale drops right away, between 1 and this after a few frames
+    static constexpr double SPIKE_RATIO = 1.2;
+    static constexpr uint32_t OVER_BUDGET_FRAMES = 3;
+    // Under this fraction of the budget for this many frames the scale climbs back
+    static constexpr double HEADROOM_RATIO = 0.85;
+    static constexpr uint32_t HEADROOM_FRAMES = 30;
+    static constexpr float MAX_STEP_UP = 1.05f;
+    static constexpr uint32_t TILE_SIZE = 8;
+
+    double m_target_ms = 1000.0 / 60.0;
+    float m_min_scale = 0.5f;
+    float m_max_scale = 1.0f;
+    float m_scale = 1.0f;
+    uint32_t m_latency_frames = 2;
+    // Samples still rendered at a previous scale, which are skipped
+    uint32_t m_settle_frames = 0;
+    uint32_t m_over_budget_frames = 0;
+    uint32_t m_headroom_frames = 0;
+
+    void set_scale(float scale);
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include "vulkan/vulkan.h"
+#include <array>
+#include <string>
+#include <vector>
+
+// Per-pass GPU timing using timestamp queries. Each frame in flight owns its own query pool, and results are read
+// back only after that frame's timeline value has been waited on, so the readback never stalls the CPU.
+class GpuProfiler
+{
+public:
+    static constexpr uint32_t MAX_SCOPES_PER_FRAME = 32;
+    static constexpr size_t HISTORY_SIZE = 512;
+
+    struct PassStats
+    {
+        std::string name;
+        std::array<double, HISTORY_SIZE> history = {};
+        size_t history_count = 0;
+        size_t history_head = 0;
+        double last_ms = 0.0;
+        // Number of the collect that read last_ms
+        uint64_t last_collect = 0;
+
+        void add_sample(double ms);
+        double average() const;
+        double percentile(double p) const;
+        double max() const;
+    };
+
+    void init(VkDevice device, VkPhysicalDevice physical_device, uint32_t queue_family_index, uint32_t frame_count);
+    void destroy();
+
+    // Collect the previous results of this frame slot, then reset its queries. Call right after the frame slot wait
+    // and before any scope is recorded into the frame's command buffer.
+    bool collect(uint32_t frame_slot);
+    void begin_frame(VkCommandBuffer cmd, uint32_t frame_slot);
+
+    uint32_t begin_scope(VkCommandBuffer cmd, const char* name);
+    void end_scope(VkCommandBuffer cmd, uint32_t scope_index);
+
+    double get_last_ms(const char* name) const;
+    // Like get_last_ms, but false unless the last successful collect read the scope
+    bool get_collected_ms(const char* name, double& ms) const;
+    const std::vector<PassStats>& get_stats() const
+    {
+        return m_stats;
+    }
+
+    void draw_imgui_panel();
+    bool dump_csv(const char* file_path) const;
+
+private:
+    struct FrameQueries
+    {
+        VkQueryPool query_pool = VK_NULL_HANDLE;
+        std::vector<const char*> scope_names;
+        bool pending = false;
+    };
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    double m_ns_per_tick = 0.0;
+    uint64_t m_valid_bits_mask = 0;
+    bool m_enabled = false;
+    uint32_t m_current_slot = 0;
+    uint64_t m_collect_count = 0;
+    std::vector<FrameQueries> m_frames;
+    std::vector<PassStats> m_stats;
+
+    PassStats& find_or_add_stats(const char* name);
+};
+
+// Records begin/end timestamps around the lifetime of the scope
+class GpuProfileScope
+{
+public:
+    GpuProfileScope(GpuProfiler& profiler, VkCommandBuffer cmd, const char* name)
+        : m_profiler(profiler), m_cmd(cmd), m_scope_index(profiler.begin_scope(cmd, name))
+    {
+    }
+    ~GpuProfileScope()
+    {
+        m_profiler.end_scope(m_cmd, m_scope_index);
+    }
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+    GpuProfiler& m_profiler;
+    VkCommandBuffer m_cmd;
+    uint32_t m_scope_index;
+};
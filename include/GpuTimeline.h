@@ -0,0 +1,40 @@
+#pragma once
+#include "Types.h"
+
+#include <atomic>
+
+// Timeline semaphore signaled by every submission to the graphics queue. Values are handed out under the queue lock
+// right before vkQueueSubmit2, so they increase in submission order and "has value N completed?" covers everything
+// submitted up to and including N. Replaces per-frame and per-submit fences.
+class GpuTimeline
+{
+public:
+    void init(VkDevice device);
+    void destroy();
+
+    // Call with the queue lock held, immediately before submitting the work that signals the returned value
+    uint64_t next_value();
+    VkSemaphoreSubmitInfo signal_info(uint64_t value, VkPipelineStageFlags2 stage) const;
+
+    uint64_t get_submitted_value() const
+    {
+        return m_submitted_value.load(std::memory_order_acquire);
+    }
+    uint64_t get_completed_value() const;
+    bool is_complete(uint64_t value) const
+    {
+        return value == 0 || get_completed_value() >= value;
+    }
+    // Blocks until `value` completed. Value 0 is always complete.
+    VkResult wait(uint64_t value, uint64_t timeout = UINT64_MAX) const;
+
+    VkSemaphore get_semaphore() const
+    {
+        return m_semaphore;
+    }
+
+private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkSemaphore m_semaphore = VK_NULL_HANDLE;
+    std::atomic<uint64_t> m_submitted_value = 0;
+};
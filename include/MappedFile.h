@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::filesystem::path& file_path);
+    void close();
+
+    const std::byte* data() const
+    {
+        return static_cast<const std::byte*>(m_data);
+    }
+    size_t size() const
+    {
+        return m_size;
+    }
+    bool is_open() const
+    {
+        return m_data != nullptr;
+    }
+
+private:
+    void* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file_handle = nullptr;
+    void* m_mapping_handle = nullptr;
+#endif
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include "MappedFile.h"
+#include "SceneLoader.h"
+
+#include <filesystem>
+#include <span>
+#include <vector>
+
+// Cooked scene opened straight from a memory-mapped .bkmesh file. The vertex, index and instance spans point into the
+// mapping and are laid out exactly like the GPU buffers, so they can be handed to the uploader without a parse step.
+class CookedScene
+{
+public:
+    bool open(const std::filesystem::path& cooked_path);
+    void close();
+
+    SceneView view() const;
+    uint64_t get_source_size() const
+    {
+        return m_source_size;
+    }
+    int64_t get_source_write_time() const
+    {
+        return m_source_write_time;
+    }
+    uint64_t get_source_hash() const
+    {
+        return m_source_hash;
+    }
+
+private:
+    MappedFile m_file;
+    uint64_t m_source_size = 0;
+    int64_t m_source_write_time = 0;
+    uint64_t m_source_hash = 0;
+
+    std::span<const Vertex> m_vertices;
+    std::span<const uint32_t> m_indices;
+    std::span<const GPUInstanceTransform> m_instance_transforms;
+    std::span<const uint32_t> m_instance_meshes;
+    std::span<const ScenePrimitive> m_primitives;
+    std::span<const GPUMeshlet> m_meshlets;
+    std::vector<SceneMesh> m_meshes;
+};
+
+namespace mesh_cache
+{
+    // Cooked file that sits next to the source, e.g. "sponza.glb.bkmesh"
+    std::filesystem::path cooked_path_for(const std::filesystem::path& source_path);
+
+    // Content hash of the source file
+    uint64_t hash_file(const std::filesystem::path& file_path);
+
+    // The cooked file is current when the source's size and write time match. A touched but unchanged source is
+    // recognised by its content hash. External .bin buffers of a .gltf are not tracked.
+    bool is_up_to_date(const CookedScene& cooked, const std::filesystem::path& source_path);
+
+    bool write(const SceneData& scene, const std::filesystem::path& source_path, const std::filesystem::path& cooked_path);
+
+    // Offline cook: load the source with the regular glTF loader and write the cooked file
+    bool cook(const std::filesystem::path& source_path, const std::filesystem::path& cooked_path, ThreadPool& thread_pool);
+} // namespace mesh_cache
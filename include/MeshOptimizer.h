@@ -0,0 +1,69 @@
+#pragma once
+#include "Types.h"
+
+#include <span>
+#include <vector>
+
+// Import-time reordering of one indexed triangle list. Everything works in place on a primitive's own vertex and
+// index ranges; indices are local to the vertex range.
+namespace mesh_optimizer
+{
+    // FIFO post-transform cache the optimizer and the ACMR numbers assume
+    constexpr uint32_t CACHE_SIZE = 16;
+    // Cluster split point for overdraw ordering: a cluster may end once its ACMR is within this factor of the
+    // cache-optimized order's, so the reordering costs at most ~5% of the cache gains
+    constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+    struct Stats
+    {
+        size_t triangle_count = 0;
+        size_t vertex_count_before = 0;
+        size_t vertex_count_after = 0;
+        // Simulated post-transform cache misses over the whole list
+        size_t cache_misses_before = 0;
+        size_t cache_misses_after = 0;
+
+        void add(const Stats& other);
+        // Average cache miss ratio: transformed vertices per triangle
+        float acmr_before() const;
+        float acmr_after() const;
+    };
+
+    // Merge bitwise identical vertices and compact the rest to the front. Returns the new vertex count.
+    size_t deduplicate_vertices(std::span<Vertex> vertices, std::span<uint32_t> indices);
+
+    // Tipsify (Sander et al. 2007): fan around recently transformed vertices to keep them in the cache. Writes the
+    // index of the first triangle of each cache-cold run to `hard_boundaries`.
+    void optimize_vertex_cache(std::span<uint32_t> indices,
+                               size_t vertex_count,
+                               std::vector<uint32_t>* hard_boundaries = nullptr);
+
+    // Split the cache-optimized order into clusters and draw the outward-facing ones first, so they occlude the rest
+    void optimize_overdraw(std::span<uint32_t> indices,
+                           std::span<const Vertex> vertices,
+                           std::span<const uint32_t> hard_boundaries);
+
+    // Reorder vertices by first use and drop unreferenced ones. Returns the new vertex count.
+    size_t optimize_vertex_fetch(std::span<Vertex> vertices, std::span<uint32_t> indices);
+
+    size_t simulate_cache_misses(std::span<const uint32_t> indices, size_t vertex_count);
+
+    // Every pass above in order. Returns the stats; the primitive keeps its first `vertex_count_after` vertices.
+    Stats optimize(std::span<Vertex> vertices, std::span<uint32_t> indices);
+
+    // Edge-collapse simplification with quadric error metrics (Garland and Heckbert 1997). A collapse folds a vertex
+    // onto a neighbour without moving it, so the result indexes the same vertex range. Vertices on open borders and
+    // attribute seams stay locked. Stops at `target_index_count` or when nothing can collapse; `out_error` receives
+    // the object-space distance the surface moved by, as estimated by the quadrics.
+    std::vector<uint32_t> simplify(std::span<const uint32_t> indices,
+                                   std::span<const Vertex> vertices,
+                                   size_t target_index_count,
+                                   float& out_error);
+
+    // Split a triangle list into meshlets in order, so each one is a contiguous index range of at most
+    // MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles. Run it on cache-optimized indices, whose
+    // runs are already compact. Appends to `meshlets`; first_index is relative to the start of `indices`.
+    void build_meshlets(std::span<const uint32_t> indices,
+                        std::span<const Vertex> vertices,
+                        std::vector<GPUMeshlet>& meshlets);
+} // namespace mesh_optimizer
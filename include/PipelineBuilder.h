@@ -18,7 +18,7 @@ public:
     PipelineBuilder();
     ~PipelineBuilder();
     void clear();
-    VkPipeline build_pipeline(VkDevice device);
+    VkPipeline build_pipeline(VkDevice device, VkPipelineCache pipeline_cache = VK_NULL_HANDLE);
     void set_shaders(VkShaderModule vertex_shader, VkShaderModule fragment_shader);
     void set_input_topology(VkPrimitiveTopology topology);
     void set_polygon_mode(VkPolygonMode mode);
@@ -0,0 +1,57 @@
+#pragma once
+#include "vulkan/vulkan.h"
+
+#include <mutex>
+#include <string>
+
+// VkPipelineCache persisted to disk between runs. The file is only reused when it was written by the same device
+// (vendor, device id, pipeline cache UUID) and driver version, and its payload checksum matches.
+class PipelineCache
+{
+public:
+    void init(VkDevice device, VkPhysicalDevice physical_device, const char* file_path);
+    void save();
+    void destroy();
+
+    VkPipelineCache get() const
+    {
+        return m_cache;
+    }
+    bool is_warm() const
+    {
+        return m_warm;
+    }
+
+    // Startup instrumentation, safe to call from several threads
+    void record_pipeline_build(const char* name, double milliseconds);
+    void print_stats() const;
+
+private:
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t header_version;
+        uint32_t vendor_id;
+        uint32_t device_id;
+        uint32_t driver_version;
+        uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+        uint64_t data_size;
+        uint64_t data_hash;
+        // Pipeline build time of the run that started without a cache, used to report savings on warm starts
+        double cold_build_ms;
+    };
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties m_properties = {};
+    VkPipelineCache m_cache = VK_NULL_HANDLE;
+    std::string m_file_path;
+    bool m_warm = false;
+    size_t m_loaded_bytes = 0;
+    double m_cold_build_ms = 0.0;
+
+    mutable std::mutex m_stats_mutex;
+    double m_build_ms = 0.0;
+    uint32_t m_build_count = 0;
+
+    FileHeader make_header() const;
+};
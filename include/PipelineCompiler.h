@@ -0,0 +1,53 @@
+#pragma once
+#include "PipelineCache.h"
+#include "ThreadPool.h"
+#include "vulkan/vulkan.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+
+// A pipeline being compiled on the thread pool. The render loop either polls it and skips work that needs it, or
+// blocks on it when the pass cannot be skipped.
+class PipelineJob
+{
+public:
+    bool valid() const
+    {
+        return m_future.valid();
+    }
+    bool is_ready() const;
+    // VK_NULL_HANDLE while still compiling
+    VkPipeline try_get() const;
+    VkPipeline get() const;
+
+private:
+    friend class PipelineCompiler;
+    std::shared_future<VkPipeline> m_future;
+};
+
+class PipelineCompiler
+{
+public:
+    using BuildFunction = std::function<VkPipeline(VkPipelineCache pipeline_cache)>;
+
+    void init(PipelineCache* pipeline_cache, ThreadPool* thread_pool);
+
+    // `build` runs on a worker thread. It should load its own shader modules and destroy them when done.
+    PipelineJob enqueue(std::string name, BuildFunction&& build);
+    void wait_idle();
+
+private:
+    PipelineCache* m_pipeline_cache = nullptr;
+    ThreadPool* m_thread_pool = nullptr;
+
+    std::mutex m_mutex;
+    std::condition_variable m_idle_condition;
+    uint32_t m_outstanding = 0;
+    uint32_t m_batch_count = 0;
+    std::chrono::steady_clock::time_point m_batch_start;
+};
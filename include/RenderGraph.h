@@ -0,0 +1,148 @@
+#pragma once
+#include "vulkan/vulkan.h"
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+class GpuProfiler;
+
+using RGHandle = uint32_t;
+
+// Per-frame graph of passes that declare how they touch images and buffers. Executing it culls passes whose results
+// nobody consumes, then records the survivors in order with one merged vkCmdPipelineBarrier2 in front of each,
+// carrying only the stages and accesses that actually conflict. Resource state (layout, last writer, readers since)
+// persists across frames, keyed by the Vulkan handle, so the first barrier of a frame syncs against the previous one.
+class RenderGraph
+{
+public:
+    using ExecuteFunction = std::function<void(VkCommandBuffer cmd)>;
+
+    class PassBuilder
+    {
+    public:
+        PassBuilder& read(RGHandle resource,
+                          VkPipelineStageFlags2 stage,
+                          VkAccessFlags2 access,
+                          VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+        // `discard` means the pass overwrites everything, so the previous contents (and layout) can be dropped
+        PassBuilder& write(RGHandle resource,
+                           VkPipelineStageFlags2 stage,
+                           VkAccessFlags2 access,
+                           VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                           bool discard = false);
+        // Keep the pass even when nothing in the graph reads what it writes, e.g. host readbacks
+        PassBuilder& side_effect();
+
+    private:
+        friend class RenderGraph;
+        PassBuilder(RenderGraph& graph, uint32_t pass_index) : m_graph(graph), m_pass_index(pass_index)
+        {
+        }
+        RenderGraph& m_graph;
+        uint32_t m_pass_index;
+    };
+
+    RGHandle import_image(VkImage image, VkImageAspectFlags aspect);
+    RGHandle import_buffer(VkBuffer buffer);
+    // Forget the tracked state and treat `stage` as the image's last use, e.g. the stage a semaphore is waited on for
+    // a freshly acquired swapchain image (contents undefined) or an image written on another queue (in `layout`)
+    void set_initial_state(RGHandle image,
+                           VkPipelineStageFlags2 stage,
+                           VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+    // Layout to leave the image in after the last pass. Also makes it a graph output.
+    void set_final_layout(RGHandle image, VkImageLayout layout);
+    // Consumed outside the graph, so its last writers are never culled
+    void mark_output(RGHandle resource);
+    // The two images share memory. Whichever is used first in a frame drops its contents and waits for the last
+    // uses of the other.
+    void alias(RGHandle a, RGHandle b);
+
+    PassBuilder add_pass(const char* name, ExecuteFunction&& execute);
+
+    // Cull, synchronize and record every pass, then start a new empty graph
+    void execute(VkCommandBuffer cmd, GpuProfiler* profiler = nullptr);
+
+    // Drop every tracked state, e.g. after the device went idle and resources were recreated
+    void forget_all();
+    // Drop the state of one image that is being destroyed, so a later image reusing the handle starts out clean
+    void forget(VkImage image);
+
+    // First and last recorded pass that touched the image in the last executed graph, counting only passes that
+    // survived culling. Returns false if the image was not used.
+    bool get_lifetime(VkImage image, uint32_t& first_pass, uint32_t& last_pass) const;
+
+    uint32_t get_last_pass_count() const
+    {
+        return m_last_pass_count;
+    }
+    uint32_t get_last_culled_pass_count() const
+    {
+        return m_last_culled_pass_count;
+    }
+    uint32_t get_last_barrier_count() const
+    {
+        return m_last_barrier_count;
+    }
+
+private:
+    struct ResourceState
+    {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags2 write_stage = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 write_access = VK_ACCESS_2_NONE;
+        // Readers since the last write, the next writer has to wait for them
+        VkPipelineStageFlags2 read_stages = VK_PIPELINE_STAGE_2_NONE;
+        // Already synchronized against the last write
+        VkPipelineStageFlags2 visible_stages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 visible_access = VK_ACCESS_2_NONE;
+    };
+
+    struct Resource
+    {
+        uint64_t key = 0;
+        VkImage image = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImageAspectFlags aspect = 0;
+        VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        bool output = false;
+        std::vector<RGHandle> aliases;
+    };
+
+    struct Lifetime
+    {
+        uint32_t first_pass = 0;
+        uint32_t last_pass = 0;
+    };
+
+    struct Access
+    {
+        RGHandle resource;
+        VkPipelineStageFlags2 stage;
+        VkAccessFlags2 access;
+        VkImageLayout layout;
+        bool write;
+        bool discard;
+    };
+
+    struct Pass
+    {
+        const char* name;
+        ExecuteFunction execute;
+        std::vector<Access> accesses;
+        bool side_effect = false;
+    };
+
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::unordered_map<uint64_t, ResourceState> m_states;
+    std::unordered_map<uint64_t, Lifetime> m_lifetimes;
+    uint32_t m_last_pass_count = 0;
+    uint32_t m_last_culled_pass_count = 0;
+    uint32_t m_last_barrier_count = 0;
+
+    RGHandle add_resource(const Resource& resource);
+    void add_access(uint32_t pass_index, const Access& access);
+    std::vector<bool> cull_passes() const;
+};
@@ -1,21 +1,46 @@
 #pragma once
 #include "Types.h"
+#include "GpuProfiler.h"
+#include "GpuTimeline.h"
+#include "DynamicResolution.h"
+#include "Uploader.h"
+#include "StagingRing.h"
+#include "PipelineCache.h"
+#include "PipelineCompiler.h"
+#include "ThreadPool.h"
+#include "SceneLoader.h"
+#include "DepthPyramid.h"
+#include "RenderGraph.h"
+#include "TransientAllocator.h"
+#include "BindlessTable.h"
 #include "SDL3/SDL.h"
 #include "VkBootstrap.h"
 #include "vma/vk_mem_alloc.h"
 #include <vulkan/vulkan_core.h>
 #include <array>
+#include <mutex>
 
 class Renderer
 {
 public:
-    void init();
+    void init(const RendererSettings& settings = {});
     void destroy();
     void run();
+    BenchmarkResult run_benchmark(uint32_t frame_count, uint32_t warmup_frame_count = 16);
+    bool dump_gpu_profile(const char* file_path) const;
 
 private:
-    static constexpr unsigned int FRAMES_IN_FLIGHT = 2;
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+    static constexpr uint32_t MAX_RECORDING_THREADS = 16;
+    static constexpr VkDeviceSize STAGING_RING_PARTITION_SIZE = 16 * 1024 * 1024;
+    // Part of each partition uploads can't take: the cull data and streamed transforms of a frame
+    static constexpr VkDeviceSize STAGING_RING_FRAME_REGION_SIZE = 4 * 1024 * 1024;
+    // First pool of each frame's descriptor allocator; the depth pyramid alone takes one set per level
+    static constexpr uint32_t FRAME_DESCRIPTOR_SETS = 32;
+    // Cap on the meshlet index stream (64 MB). Meshlets that don't fit are dropped for the frame and counted.
+    static constexpr uint32_t MAX_MESHLET_STREAM_INDICES = 16 * 1024 * 1024;
 
+    RendererSettings m_settings;
     VmaAllocator m_vma_allocator;
     DeletionQueue m_deletion_queue;
 
@@ -26,29 +51,104 @@ private:
     vkb::PhysicalDevice m_physical_device = {};
     vkb::Device m_device = {};
     SwapchainData m_swapchain_data;
+    ThreadPool m_thread_pool;
+    PipelineCache m_pipeline_cache;
+    PipelineCompiler m_pipeline_compiler;
+    bool m_descriptor_buffer_supported = false;
+    BindlessTable m_bindless_table;
 
-    std::array<FrameData, FRAMES_IN_FLIGHT> m_frame_data;
+    std::mutex m_graphics_queue_mutex;
+    // Signaled by every graphics submit: paces the frame slots and deferred deletion
+    GpuTimeline m_timeline;
+    TimelineDeletionQueue m_timeline_deletion_queue;
+    // Separate compute family picked by vkb, if the device has one. The next async dispatch waits for the device
+    // timeline value of the previous frame, its last read of the draw image.
+    VkQueue m_compute_queue = VK_NULL_HANDLE;
+    uint32_t m_compute_queue_family = 0;
+    bool m_enable_async_compute = false;
+    VkSemaphore m_async_compute_semaphore = VK_NULL_HANDLE;
+    uint64_t m_async_compute_value = 0;
+    GpuProfiler m_compute_profiler;
+    double m_last_background_ms = 0.0;
+    StagingRing m_staging_ring;
+    Uploader m_uploader;
+    uint64_t m_frame_upload_wait_value = 0;
+
+    uint32_t m_frames_in_flight = 2;
+    std::array<FrameData, MAX_FRAMES_IN_FLIGHT> m_frame_data;
     std::vector<VkSemaphore> m_submit_semaphores;
     uint32_t m_frame_index = 0;
+    GpuProfiler m_gpu_profiler;
+    double m_last_gpu_frame_ms = 0.0;
+    // Whether the last draw_frame read back a new graphics frame time into m_last_gpu_frame_ms
+    bool m_gpu_frame_collected = false;
+    // Input sampling to observed GPU completion of the frame that used it. Presentation adds up to one refresh on top.
+    std::chrono::steady_clock::time_point m_input_sample_time = {};
+    double m_last_input_latency_ms = 0.0;
+    double m_average_input_latency_ms = 0.0;
+    RenderGraph m_render_graph;
+    TransientAllocator m_transient_allocator;
+    // High-water mark of the swapchain extent; the targets only grow, draw_extent_2D is what gets rendered
+    VkExtent2D m_render_target_extent = {};
+    DynamicResolution m_dynamic_resolution;
+    uint32_t m_draw_image_target = 0;
+    uint32_t m_depth_image_target = 0;
+    bool m_render_targets_dirty = false;
 
+    PipelineJob m_triangle_pipeline_job;
     VkPipeline m_triangle_pipeline = VK_NULL_HANDLE;
     VkPipelineLayout m_triangle_pipeline_layout = VK_NULL_HANDLE;
-    GPUDrawPushConstants m_rectangle_push_constants;
     GPUMeshBuffers m_rectangle;
+    GPUDrawList m_rectangle_draw_list;
+    std::vector<glm::mat4> m_rectangle_instance_transforms;
+    GPUScene m_scene;
+    bool m_stream_instance_transforms = false;
+
+    PipelineJob m_cull_pipeline_job;
+    VkPipeline m_cull_pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout m_cull_pipeline_layout = VK_NULL_HANDLE;
+    // Shares the cull pipeline layout
+    PipelineJob m_meshlet_cull_pipeline_job;
+    VkPipeline m_meshlet_cull_pipeline = VK_NULL_HANDLE;
+    bool m_enable_gpu_culling = true;
+    bool m_enable_occlusion_culling = true;
+    bool m_enable_meshlet_culling = false;
+    float m_lod_error_pixels = 1.0f;
+    bool m_enable_direct_draws = false;
+    // Ranges the direct draws are split into, up to the pools created per frame
+    uint32_t m_recording_threads = 1;
+    uint32_t m_max_recording_threads = 1;
+    double m_last_recording_ms = 0.0;
+    double m_average_recording_ms = 0.0;
+    DepthPyramid m_depth_pyramid;
+    uint32_t m_depth_pyramid_texture = BindlessTable::INVALID_INDEX;
+    uint32_t m_depth_pyramid_sampler = BindlessTable::INVALID_INDEX;
+    glm::mat4 m_previous_view_projection = glm::mat4(1.0f);
+    // Geometry picked and culled this frame, drawn by draw_triangle
+    struct CulledGeometry
+    {
+        const GPUMeshBuffers* mesh = nullptr;
+        const GPUDrawList* draw_list = nullptr;
+        VkDeviceAddress transform_buffer = 0;
+        VkDeviceAddress cull_data = 0;
+        bool occlusion = false;
+        bool meshlets = false;
+        // Recorded by draw_direct instead of culled
+        bool direct = false;
+    } m_culled_geometry;
+    // Cull counters copied back once per frame slot, read after that slot's timeline value completed
+    AllocatedBuffer m_cull_stats_readback = {};
+    std::array<bool, MAX_FRAMES_IN_FLIGHT> m_cull_stats_pending = {};
+    GPUCullStats m_cull_stats = {};
+    uint32_t m_cull_stats_draw_count = 0;
 
-    VkDescriptorSetLayout m_compute_descriptor_layout = VK_NULL_HANDLE;
-    VkDescriptorPool m_compute_descriptor_pool = VK_NULL_HANDLE;
-    VkDescriptorSet m_compute_descriptor_set = VK_NULL_HANDLE;
     VkPipelineLayout m_compute_layout = VK_NULL_HANDLE;
+    PipelineJob m_compute_pipeline_job;
     VkPipeline m_compute_pipeline = VK_NULL_HANDLE;
     ComputePushConstants m_compute_push_constants;
     MousePos m_mouse_pos;
     MousePos m_mouse_scale{ 1.0f, 1.0f };
 
-    VkFence m_imm_fence = VK_NULL_HANDLE;
-    VkCommandBuffer m_imm_command_buffer = VK_NULL_HANDLE;
-    VkCommandPool m_imm_command_pool = VK_NULL_HANDLE;
-
     void init_sdl();
     void update_window_extent();
     void update_mouse_position();
@@ -56,36 +156,80 @@ private:
     void create_surface();
     void pick_physical_device();
     void create_device();
+    void init_thread_pool();
+    void init_pipeline_cache();
     void create_swapchain();
     void recreate_swapchain();
     void init_vma();
+    void init_staging_ring();
+    void init_uploader();
+    bool upload_ready_for_frame(const UploadTicket& upload);
 
     AllocatedBuffer create_buffer(size_t alloc_size, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage);
     void destroy_buffer(AllocatedBuffer& buffer);
-    void create_draw_image();
-    void create_depth_image();
-    void destroy_image(AllocatedImage& img);
-    void destroy_draw_image(AllocatedImage& img);
+    void init_render_targets();
+    void resize_render_targets();
+    void create_render_targets();
+    void retire_render_targets();
+    void recreate_render_targets();
+    void resize_depth_pyramid();
+    void register_depth_pyramid();
+    // Apply the dynamic resolution scale to the draw extent
+    void update_draw_extent();
+    void update_render_target_lifetimes();
 
     void init_imgui();
     void draw_imgui(VkCommandBuffer cmd, VkImageView target_image_view);
 
     void create_command_buffers();
     void init_sync_structures();
+    void init_gpu_profiler();
+    // Returns true when a new graphics frame time arrived
+    bool collect_gpu_timings(uint32_t frame_slot);
     void init_descriptors();
     void init_triangle_pipeline();
     void init_compute_pipeline();
-    void draw_triangle(VkCommandBuffer cmd);
+    void init_depth_pyramid();
+    void init_cull_pipeline();
+    // Picks the frame's geometry. Returns true when it goes through the cull passes.
+    bool select_culled_geometry();
+    void cull_geometry(VkCommandBuffer cmd, GPUCullPhase phase);
+    void cull_meshlets(VkCommandBuffer cmd, GPUCullPhase phase);
+    void copy_cull_stats(VkCommandBuffer cmd, uint32_t frame_slot);
+    void collect_cull_stats(uint32_t frame_slot);
+    void draw_triangle(VkCommandBuffer cmd, GPUCullPhase phase);
+    // Pipeline, dynamic state, index buffer and push constants of the geometry pass
+    void bind_geometry_state(VkCommandBuffer cmd, VkDeviceAddress visible_buffer);
+    void draw_direct(VkCommandBuffer cmd, VkRenderingInfo render_info);
+    void record_direct_draws(VkCommandBuffer cmd, std::span<const GPUDrawItem> items, uint32_t first_item);
+    glm::mat4 get_view() const;
+    glm::mat4 get_projection() const;
+    glm::mat4 get_view_projection() const;
     void draw_background(VkCommandBuffer cmd);
+    bool use_async_compute() const;
+    void submit_async_background(uint32_t frame_slot);
+    void build_frame_graph(uint32_t frame_slot, uint32_t swapchain_image_index);
+    // Waits for the slot's last submit and records the input latency of that frame
+    void wait_for_frame(FrameData& frame);
     void draw_frame();
 
-    GPUMeshBuffers gpu_mesh_upload(std::span<uint32_t> indices,
-                                   std::span<Vertex> vertices,
-                                   std::span<glm::mat4> instance_transforms);
-    void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function);
+    // With quantized vertices each vertex is encoded against the bounds of mesh `vertex_meshes[v]`, and the vertex
+    // shader finds an instance's bounds through `instance_meshes`. Both are ignored otherwise.
+    GPUMeshBuffers gpu_mesh_upload(std::span<const uint32_t> indices,
+                                   std::span<const Vertex> vertices,
+                                   std::span<const GPUInstanceTransform> instance_transforms,
+                                   std::span<const uint32_t> vertex_meshes,
+                                   std::span<const uint32_t> instance_meshes,
+                                   uint32_t mesh_count,
+                                   std::span<const GPUMeshlet> meshlets = {});
+    // A non-zero `meshlet_index_capacity` adds the index stream the meshlet pass writes
+    GPUDrawList create_draw_list(std::span<const GPUDrawItem> draw_items, uint32_t meshlet_index_capacity = 0);
+    void destroy_draw_list(GPUDrawList& draw_list);
     void init_default_data();
+    void load_scene(const std::filesystem::path& file_path);
+    void upload_scene(const SceneView& scene);
     FrameData& get_current_frame()
     {
-        return m_frame_data[m_frame_index % FRAMES_IN_FLIGHT];
+        return m_frame_data[m_frame_index % m_frames_in_flight];
     };
 };
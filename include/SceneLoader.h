@@ -0,0 +1,74 @@
+#pragma once
+#include "Types.h"
+#include "ThreadPool.h"
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+struct ScenePrimitive
+{
+    int32_t vertex_offset;
+    // Object-space bounding sphere, center in xyz and radius in w
+    glm::vec4 bounds_sphere;
+    // lods[0] is the full-detail index range, the rest are simplified from it
+    uint32_t lod_count;
+    GPUMeshLod lods[MAX_MESH_LODS];
+};
+
+struct SceneMesh
+{
+    std::string name;
+    uint32_t first_primitive;
+    uint32_t primitive_count;
+};
+
+// Read-only view of a scene's arrays, backed either by a SceneData or by a memory-mapped cooked file
+struct SceneView
+{
+    std::span<const Vertex> vertices;
+    std::span<const uint32_t> indices;
+    std::span<const SceneMesh> meshes;
+    std::span<const ScenePrimitive> primitives;
+    std::span<const GPUInstanceTransform> instance_transforms;
+    std::span<const uint32_t> instance_meshes;
+    std::span<const GPUMeshlet> meshlets;
+};
+
+// CPU-side scene with every primitive packed into shared vertex/index arrays. `instance_transforms[i]` places
+// `meshes[instance_meshes[i]]` in the world.
+struct SceneData
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<SceneMesh> meshes;
+    std::vector<ScenePrimitive> primitives;
+    std::vector<GPUInstanceTransform> instance_transforms;
+    std::vector<uint32_t> instance_meshes;
+    std::vector<GPUMeshlet> meshlets;
+
+    SceneView view() const
+    {
+        return { vertices, indices, meshes, primitives, instance_transforms, instance_meshes, meshlets };
+    }
+};
+
+// Scene whose shared buffers have been handed to the uploader
+struct GPUScene
+{
+    bool loaded = false;
+    GPUMeshBuffers buffers;
+    GPUDrawList draw_list;
+    std::vector<SceneMesh> meshes;
+    std::vector<ScenePrimitive> primitives;
+    std::vector<uint32_t> instance_meshes;
+};
+
+namespace loader
+{
+    // Loads a .gltf or .glb file. The file is memory-mapped, and meshes are decoded in parallel on `thread_pool`
+    // straight into their final place in the shared arrays.
+    std::optional<SceneData> load_gltf(const std::filesystem::path& file_path, ThreadPool& thread_pool);
+} // namespace loader
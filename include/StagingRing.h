@@ -0,0 +1,80 @@
+#pragma once
+#include "Types.h"
+
+#include <mutex>
+#include <vector>
+
+struct StagingAllocation
+{
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;
+    VkDeviceAddress device_address = 0;
+    uint32_t partition = 0;
+};
+
+// One persistently mapped buffer split into a partition per frame in flight. Each partition starts with a frame region
+// for per-frame constants, reclaimed every time the frame slot comes around (after its timeline value), followed by an
+// upload region that is only reclaimed once every upload sourced from it has completed. A slow upload therefore never
+// takes the space the frame needs.
+class StagingRing
+{
+public:
+    // `frame_region_size` bytes of each partition are reserved for allocate(), the rest is left to uploads
+    void init(VkDevice device,
+              VmaAllocator allocator,
+              VkDeviceSize partition_size,
+              VkDeviceSize frame_region_size,
+              uint32_t partition_count);
+    void destroy();
+
+    // Make `frame_slot` the current partition. `completed_upload_value` is the uploader timeline value reached so far.
+    void begin_frame(uint32_t frame_slot, uint64_t completed_upload_value);
+
+    // Per-frame data from the current frame region. Returns false when it is out of space; callers fall back.
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, StagingAllocation& out_allocation);
+    // Upload source data from the current upload region. The first allocation of a batch in a partition (its bit in
+    // `pinned_partitions` is clear) pins the partition in the same locked step, so begin_frame can't reclaim it in
+    // between. It stays pinned until retain_for_upload and then until the uploader timeline reaches the batch's value.
+    bool allocate_for_upload(VkDeviceSize size,
+                             VkDeviceSize alignment,
+                             uint32_t& pinned_partitions,
+                             StagingAllocation& out_allocation);
+    void flush(const StagingAllocation& allocation);
+
+    void retain_for_upload(uint32_t partition, uint64_t upload_value);
+
+    VkDeviceSize get_partition_size() const
+    {
+        return m_partition_size;
+    }
+    VkDeviceSize get_used_bytes(uint32_t partition) const;
+
+private:
+    struct Partition
+    {
+        VkDeviceSize frame_head = 0;
+        VkDeviceSize upload_head = 0;
+        uint32_t open_uploads = 0;
+        uint64_t retire_upload_value = 0;
+    };
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+    AllocatedBuffer m_buffer = {};
+    VkDeviceAddress m_device_address = 0;
+    bool m_coherent = true;
+    VkDeviceSize m_partition_size = 0;
+    VkDeviceSize m_frame_region_size = 0;
+    uint32_t m_current_partition = 0;
+    std::vector<Partition> m_partitions;
+    mutable std::mutex m_mutex;
+
+    // Bump `head` within [region_start, region_end) of the current partition, called with the lock held
+    bool allocate_locked(VkDeviceSize& head,
+                         VkDeviceSize region_end,
+                         VkDeviceSize size,
+                         VkDeviceSize alignment,
+                         StagingAllocation& out_allocation);
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads pulling jobs from one FIFO queue
+class ThreadPool
+{
+public:
+    void init(uint32_t thread_count = 0);
+    void destroy();
+
+    uint32_t get_thread_count() const
+    {
+        return static_cast<uint32_t>(m_workers.size());
+    }
+
+    template <typename F>
+    auto submit(F&& job) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+    {
+        using Result = std::invoke_result_t<std::decay_t<F>>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+        std::future<Result> future = task->get_future();
+        {
+            std::lock_guard lock(m_mutex);
+            m_jobs.emplace_back([task]() { (*task)(); });
+        }
+        m_condition.notify_one();
+        return future;
+    }
+
+private:
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop = false;
+
+    void worker_loop();
+};
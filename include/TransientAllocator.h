@@ -0,0 +1,102 @@
+#pragma once
+#include "Types.h"
+
+#include <vector>
+
+struct TransientImageDesc
+{
+    const char* name = nullptr;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkImageUsageFlags usage = 0;
+    VkExtent3D extent = {};
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    // Used by more than one queue family, e.g. written on the async compute queue
+    bool concurrent = false;
+};
+
+// Render targets whose contents only live within a frame. Each image has a lifetime in pass indices over the
+// frame; images whose lifetimes do not overlap are placed at overlapping offsets of shared VMA memory blocks. Until
+// a real lifetime is known an image is assumed to live through the whole frame, which disables aliasing for it.
+// Aliased images share memory, so their contents never survive to the next frame.
+class TransientAllocator
+{
+public:
+    // `queue_families` are shared by concurrent images; with fewer than two every image is exclusive
+    void init(VkDevice device, VmaAllocator allocator, std::vector<uint32_t> queue_families = {});
+    void destroy();
+
+    uint32_t add_image(const TransientImageDesc& desc);
+    void set_extent(uint32_t image, VkExtent3D extent);
+    void set_lifetime(uint32_t image, uint32_t first_pass, uint32_t last_pass);
+
+    // Create every image and place it. Call release() first when images already exist.
+    void allocate();
+    // Destroy the images and their memory. They must not be in use by the GPU anymore.
+    void release();
+    // Like release(), but hand the images and memory to `deletion_queue` so frames in flight can finish with them
+    void retire(TimelineDeletionQueue& deletion_queue);
+    // True when the current lifetimes would alias images differently than the allocated placement
+    bool is_placement_stale() const;
+
+    // Only valid between allocate() and release(). The allocation member is null, the memory belongs to a block.
+    const AllocatedImage& get_image(uint32_t image) const
+    {
+        return m_images[image].image;
+    }
+    uint32_t get_image_count() const
+    {
+        return static_cast<uint32_t>(m_images.size());
+    }
+    // Whether two images share memory, in which case whoever records them has to order their uses
+    bool aliases(uint32_t a, uint32_t b) const;
+
+    // What the images would take with dedicated allocations, and what the blocks actually take
+    VkDeviceSize get_requested_bytes() const
+    {
+        return m_requested_bytes;
+    }
+    VkDeviceSize get_allocated_bytes() const
+    {
+        return m_allocated_bytes;
+    }
+    uint32_t get_block_count() const
+    {
+        return static_cast<uint32_t>(m_blocks.size());
+    }
+
+private:
+    struct Placement
+    {
+        uint32_t block = 0;
+        VkDeviceSize offset = 0;
+    };
+
+    struct Image
+    {
+        TransientImageDesc desc;
+        uint32_t first_pass = 0;
+        uint32_t last_pass = UINT32_MAX;
+        VkMemoryRequirements requirements = {};
+        Placement placement;
+        AllocatedImage image = {};
+    };
+
+    struct Block
+    {
+        uint32_t memory_type_bits = 0;
+        VkDeviceSize alignment = 1;
+        VkDeviceSize size = 0;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+    };
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+    std::vector<uint32_t> m_queue_families;
+    std::vector<Image> m_images;
+    std::vector<Block> m_blocks;
+    VkDeviceSize m_requested_bytes = 0;
+    VkDeviceSize m_allocated_bytes = 0;
+
+    // Greedy placement, largest image first, each at the lowest offset free of images with overlapping lifetimes
+    std::vector<Block> place(std::vector<Placement>& out_placements) const;
+};
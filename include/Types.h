@@ -3,10 +3,14 @@
 #include "vulkan/vk_enum_string_helper.h"
 #include "vma/vk_mem_alloc.h"
 #include "glm/glm.hpp"
+#include "DescriptorAllocator.h"
 
 #include <vector>
 #include <functional>
 #include <deque>
+#include <string>
+#include <future>
+#include <chrono>
 
 #define VK_CHECK(func)                                                                                                 \
     {                                                                                                                  \
@@ -65,22 +69,42 @@ public:
     void flush();
 };
 
-struct FrameData
+// Deletions that must wait for the GPU to finish the submissions that may still use the object. Functions pushed
+// since the last stamp() are tagged with the timeline value of the next submission.
+struct TimelineDeletionQueue
 {
 private:
-    DeletionQueue deletion_queue;
+    static constexpr uint64_t UNSTAMPED = UINT64_MAX;
+    std::deque<std::pair<uint64_t, std::function<void()>>> deletion_queue;
 
 public:
+    void push_function(std::function<void()>&& func);
+    void stamp(uint64_t value);
+    // Runs every function whose value has completed, newest first like DeletionQueue
+    void flush(uint64_t completed_value);
+    void flush_all();
+};
+
+struct FrameData
+{
     VkCommandPool command_pool;
     VkCommandBuffer command_buffer;
 
-    VkSemaphore acquire_semaphore;
-    VkFence render_fence;
+    // Async compute work of the frame, only used when the device has a separate compute family
+    VkCommandPool compute_command_pool;
+    VkCommandBuffer compute_command_buffer;
 
-    void flush_frame_data()
-    {
-        deletion_queue.flush();
-    }
+    // One pool and secondary command buffer per range of direct draws. Only one recording job touches each pool.
+    std::vector<VkCommandPool> recording_command_pools;
+    std::vector<VkCommandBuffer> recording_command_buffers;
+
+    VkSemaphore acquire_semaphore;
+    // Transient sets of the frame, reset once its timeline value completes
+    DescriptorAllocator descriptor_allocator;
+    // Device timeline value signaled by the last submit of this slot, 0 before the first one
+    uint64_t timeline_value = 0;
+    // When the input of the last submit was sampled, cleared once its latency has been recorded
+    std::chrono::steady_clock::time_point input_time = {};
 };
 
 struct Vertex
@@ -92,11 +116,176 @@ struct Vertex
     glm::vec4 color;
 };
 
+// Compact vertex, 16 bytes instead of Vertex's 48: position as unorm16 relative to its mesh's bounds, octahedral
+// normal as snorm8 in the upper half of the second word, half-float UV and RGBA8 color
+struct QuantizedVertex
+{
+    uint32_t position_xy;
+    uint32_t position_z_normal;
+    uint32_t uv;
+    uint32_t color;
+};
+
+// Dequantizes a mesh's positions: offset + unorm * extent
+struct MeshQuantization
+{
+    glm::vec4 offset;
+    glm::vec4 extent;
+};
+
+// Affine model transform stored as the top three rows of its matrix: 48 bytes instead of a mat4's 64. The bottom
+// row of an affine matrix is always (0, 0, 0, 1), so shaders expand it with three dot products.
+struct GPUInstanceTransform
+{
+    glm::vec4 rows[3];
+
+    static GPUInstanceTransform from_matrix(const glm::mat4& matrix)
+    {
+        const glm::mat4 transposed = glm::transpose(matrix);
+        return { { transposed[0], transposed[1], transposed[2] } };
+    }
+};
+
 struct GPUDrawPushConstants
 {
     glm::mat4 world_matrix;
     VkDeviceAddress vertex_buffer;
     VkDeviceAddress transform_buffer;
+    // Instance index for each indirect draw, written by the cull pass
+    VkDeviceAddress visible_buffer;
+    // Quantized vertices only: MeshQuantization per mesh and the mesh index of each instance
+    VkDeviceAddress mesh_quantization_buffer;
+    VkDeviceAddress instance_mesh_buffer;
+};
+
+// Levels of detail per primitive, including the full-detail one
+constexpr uint32_t MAX_MESH_LODS = 4;
+
+// Meshlet size limits. 124 triangles leave room for the 128-primitive budget of mesh shader hardware.
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// A run of triangles in one level's index range, tested as a unit by the meshlet cull pass
+struct GPUMeshlet
+{
+    // Object-space bounding sphere, center in xyz and radius in w
+    glm::vec4 bounds_sphere;
+    // Average normal in xyz. Seen from where the normals all point away, the meshlet is back-facing: cull when
+    // dot(center - eye, axis) >= w * |center - eye| + radius. w is 1 when the normals spread too far to ever cull.
+    glm::vec4 cone;
+    // Relative to the level's first_index
+    uint32_t first_index;
+    uint32_t triangle_count;
+    uint32_t padding[2];
+};
+
+// Index range of one level of detail. All levels of a primitive share its vertex range. `error` is how far, in
+// object space, simplification moved the surface away from the full-detail mesh.
+struct GPUMeshLod
+{
+    uint32_t first_index;
+    uint32_t index_count;
+    // The level's meshlets, which cover its index range in order
+    uint32_t first_meshlet;
+    uint32_t meshlet_count;
+    float error;
+    uint32_t padding[3];
+};
+
+// One instance of one primitive, the unit the cull pass tests and compacts
+struct GPUDrawItem
+{
+    // Object-space bounding sphere, center in xyz and radius in w
+    glm::vec4 bounds_sphere;
+    int32_t vertex_offset;
+    uint32_t instance;
+    uint32_t lod_count;
+    uint32_t padding;
+    // Finest first, with increasing error
+    GPUMeshLod lods[MAX_MESH_LODS];
+};
+
+enum GPUCullFlags : uint32_t
+{
+    CULL_FRUSTUM = 1,
+    CULL_OCCLUSION = 2,
+    CULL_DEPTH_PYRAMID_VALID = 4,
+    // Draw surviving meshlets from the meshlet index stream instead of whole levels
+    CULL_MESHLETS = 8,
+};
+
+enum GPUCullPhase : uint32_t
+{
+    // Draws what survives the frustum and last frame's depth pyramid
+    CULL_PHASE_EARLY = 0,
+    // Retests the early phase's occlusion rejects against a pyramid of this frame's early depth
+    CULL_PHASE_LATE = 1,
+};
+
+// Per-frame cull inputs, written into the staging ring and read by address
+struct GPUCullData
+{
+    glm::mat4 view_projection;
+    glm::mat4 previous_view_projection;
+    // Base level width and height, then the mip count
+    glm::vec4 depth_pyramid_size;
+    // World-space eye position in xyz
+    glm::vec4 camera_position;
+    VkDeviceAddress draw_buffer;
+    VkDeviceAddress transform_buffer;
+    VkDeviceAddress output_buffer;
+    VkDeviceAddress late_command_buffer;
+    VkDeviceAddress visible_buffer;
+    VkDeviceAddress candidate_buffer;
+    // Meshlets only: the meshlet table, the mesh's 32-bit indices, the (item, level) behind each command slot and the
+    // index stream surviving meshlets are copied into
+    VkDeviceAddress meshlet_buffer;
+    VkDeviceAddress index_buffer;
+    VkDeviceAddress slot_item_buffer;
+    VkDeviceAddress meshlet_index_buffer;
+    uint32_t draw_count;
+    uint32_t flags;
+    // Bindless table indices of the pyramid view and its sampler
+    uint32_t depth_pyramid_texture;
+    uint32_t depth_pyramid_sampler;
+    // Screen-space error in pixels of one unit of object-space error one unit in front of the camera, divided by the
+    // pixel error allowed. 0 always draws the finest level.
+    float lod_scale;
+    uint32_t meshlet_index_capacity;
+};
+
+struct GPUCullPushConstants
+{
+    VkDeviceAddress cull_data;
+    uint32_t phase;
+    uint32_t padding;
+};
+
+// Meshlet pass workgroups beyond the dispatch limit loop over the remaining draws
+constexpr uint32_t MESHLET_MAX_WORKGROUPS = 65535;
+
+// Head of the cull output buffer: the indirect draw counts of both phases and the rejection counters
+struct GPUCullStats
+{
+    uint32_t early_draw_count;
+    uint32_t late_draw_count;
+    uint32_t candidate_count;
+    uint32_t frustum_rejected;
+    uint32_t occlusion_rejected;
+    // Triangles and draws of each level of detail across both phases
+    uint32_t triangle_count;
+    uint32_t lod_draw_counts[MAX_MESH_LODS];
+    // Meshlet pass: meshlets tested and rejected, indices written to the stream, and meshlets dropped because the
+    // stream was full
+    uint32_t meshlet_count;
+    uint32_t meshlet_frustum_rejected;
+    uint32_t meshlet_cone_rejected;
+    uint32_t meshlet_index_count;
+    uint32_t meshlet_overflow;
+    uint32_t padding0;
+    // Meshlet pass workgroups of the early and late phase, one per draw up to MESHLET_MAX_WORKGROUPS
+    VkDispatchIndirectCommand meshlet_dispatch[2];
+    uint32_t padding1[2];
 };
 
 struct ComputePushConstants
@@ -105,15 +294,88 @@ struct ComputePushConstants
     glm::vec4 color1 = {};
     glm::vec4 color2 = {};
     glm::vec4 cell_coords = {};
+    // Bindless storage image index of the draw image
+    uint32_t image = 0;
+};
+
+// Handle to an asynchronous upload. `value` is the point on the uploader's timeline semaphore that signals completion.
+struct UploadTicket
+{
+    uint64_t value = 0;
+    std::shared_future<void> completion;
 };
 
 struct GPUMeshBuffers
 {
     AllocatedBuffer index_buffer;
+    // UINT16 when every index fits, which halves the index buffer
+    VkIndexType index_type;
+    uint32_t index_count;
+    VkDeviceSize index_buffer_bytes;
     AllocatedBuffer vertex_buffer;
     AllocatedBuffer instance_transform_buffer;
     VkDeviceAddress vertex_buffer_address;
     VkDeviceAddress instance_transform_buffer_address;
+    uint32_t instance_count;
+    // Set when the vertex buffer holds QuantizedVertex
+    AllocatedBuffer mesh_quantization_buffer;
+    AllocatedBuffer instance_mesh_buffer;
+    VkDeviceAddress mesh_quantization_buffer_address;
+    VkDeviceAddress instance_mesh_buffer_address;
+    VkDeviceSize vertex_bytes;
+    // Set when the geometry was split into meshlets; the index buffer is then 32-bit and readable by address
+    AllocatedBuffer meshlet_buffer;
+    VkDeviceAddress meshlet_buffer_address;
+    VkDeviceAddress index_buffer_address;
+    uint32_t meshlet_count;
+    UploadTicket upload;
+};
+
+// Draw items and the indirect arguments the cull pass compacts them into. The output buffer holds the GPUCullStats
+// header, the early and late VkDrawIndexedIndirectCommands, the instance index behind each command (early slots
+// first, late slots after `draw_count`), the early phase's occlusion rejects and the (item, level) pair behind each
+// command for the meshlet pass. Every array is sized for the case where nothing is culled.
+struct GPUDrawList
+{
+    static constexpr VkDeviceSize COMMANDS_OFFSET = sizeof(GPUCullStats);
+
+    AllocatedBuffer draw_buffer;
+    AllocatedBuffer output_buffer;
+    VkDeviceAddress draw_buffer_address;
+    VkDeviceAddress output_buffer_address;
+    uint32_t draw_count = 0;
+    // Index stream the meshlet pass fills, empty when the geometry has no meshlets
+    AllocatedBuffer meshlet_index_buffer;
+    VkDeviceAddress meshlet_index_buffer_address = 0;
+    uint32_t meshlet_index_capacity = 0;
+    // CPU copy of the items and the instance of each, the visible list of direct draws
+    std::vector<GPUDrawItem> draw_items;
+    AllocatedBuffer item_instance_buffer;
+    VkDeviceAddress item_instance_buffer_address = 0;
+    UploadTicket upload;
+
+    VkDeviceSize get_late_commands_offset() const
+    {
+        return COMMANDS_OFFSET + draw_count * sizeof(VkDrawIndexedIndirectCommand);
+    }
+    VkDeviceSize get_visible_offset() const
+    {
+        return COMMANDS_OFFSET + 2 * draw_count * sizeof(VkDrawIndexedIndirectCommand);
+    }
+    VkDeviceSize get_candidate_offset() const
+    {
+        return get_visible_offset() + 2 * draw_count * sizeof(uint32_t);
+    }
+    VkDeviceSize get_slot_item_offset() const
+    {
+        return get_candidate_offset() + draw_count * sizeof(uint32_t);
+    }
+    // End of the last region. The output buffer is always created with this size, so a region added above can't be
+    // written past the allocation.
+    VkDeviceSize get_output_size() const
+    {
+        return get_slot_item_offset() + 2 * draw_count * sizeof(glm::uvec2);
+    }
 };
 
 struct MousePos
@@ -121,3 +383,94 @@ struct MousePos
     float x = 0.0f;
     float y = 0.0f;
 };
+
+struct RendererSettings
+{
+    bool headless = false;
+    bool enable_validation = true;
+    VkExtent2D headless_extent = { 1280, 800 };
+    // Instances of the test rectangle drawn when no scene is loaded
+    uint32_t rectangle_instance_count = 10;
+    bool enable_gpu_culling = true;
+    bool enable_occlusion_culling = true;
+    // Run the background on the async compute queue when the device has one
+    bool enable_async_compute = false;
+    // 1 to Renderer::MAX_FRAMES_IN_FLIGHT. More frames keep the GPU busier at the cost of latency.
+    uint32_t frames_in_flight = 2;
+    // Falls back to FIFO when the surface doesn't support it
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    // Wait for the previous frame to finish on the GPU before sampling input
+    bool low_latency = false;
+    // Scale the rendered resolution down to hold target_frame_ms of GPU time
+    bool dynamic_resolution = false;
+    float target_frame_ms = 1000.0f / 60.0f;
+    float min_render_scale = 0.5f;
+    // Upload vertices as QuantizedVertex and draw them with the matching vertex shader
+    bool quantized_vertices = false;
+    // Cull meshlets in compute and draw the survivors from a compacted index stream. Needs a scene.
+    bool meshlet_culling = false;
+    // Largest projected simplification error in pixels a level of detail may have. 0 always draws full detail.
+    float lod_error_pixels = 1.0f;
+    // Skip the cull passes and record one vkCmdDrawIndexed per draw item at full detail on the CPU
+    bool direct_draws = false;
+    // Threads recording direct draws into secondary command buffers, at most Renderer::MAX_RECORDING_THREADS. 1 records
+    // straight into the frame's command buffer.
+    uint32_t recording_threads = 1;
+    // Back the bindless table with VK_EXT_descriptor_buffer when supported, otherwise use descriptor indexing
+    bool use_descriptor_buffer = true;
+    std::string scene_path;
+};
+
+struct BenchmarkResult
+{
+    uint32_t frame_count = 0;
+    uint32_t frames_in_flight = 0;
+    double total_seconds = 0.0;
+    double frames_per_second = 0.0;
+    double cpu_ms_per_frame = 0.0;
+    double gpu_ms_per_frame = 0.0;
+    // Measured GPU times of the cull and geometry passes, averaged like gpu_ms_per_frame, both phases summed
+    double cull_ms = 0.0;
+    double geometry_ms = 0.0;
+    // Cull counters of the last frame
+    uint32_t draw_count = 0;
+    uint32_t drawn_count = 0;
+    uint32_t frustum_rejected = 0;
+    uint32_t occlusion_rejected = 0;
+    // Transient render target memory after aliasing, and what aliasing saved over dedicated allocations
+    VkDeviceSize render_target_bytes = 0;
+    VkDeviceSize render_target_saved_bytes = 0;
+    // Whether the background ran on the async compute queue, and its GPU time there or on graphics
+    bool async_compute = false;
+    double background_ms = 0.0;
+    // Fraction of the output resolution rendered in the last frame
+    float render_scale = 1.0f;
+    // Whether the bindless table ran on VK_EXT_descriptor_buffer rather than descriptor indexing
+    bool descriptor_buffer = false;
+    // Instances behind the culled draws and the size of their transform buffer
+    uint32_t instance_count = 0;
+    VkDeviceSize instance_transform_bytes = 0;
+    // Vertex format and vertex buffer size of the culled geometry
+    bool quantized_vertices = false;
+    size_t vertex_count = 0;
+    VkDeviceSize vertex_bytes = 0;
+    // Index count and width of the culled geometry
+    size_t index_count = 0;
+    uint32_t index_size = 0;
+    // Triangles drawn and draws per level of detail in the last frame
+    uint32_t drawn_triangle_count = 0;
+    uint32_t lod_draw_counts[MAX_MESH_LODS] = {};
+    // Meshlet pass counters of the last frame, zero without --meshlets
+    bool meshlet_culling = false;
+    uint32_t meshlet_count = 0;
+    uint32_t meshlet_frustum_rejected = 0;
+    uint32_t meshlet_cone_rejected = 0;
+    uint32_t meshlet_overflow = 0;
+    // Measured GPU time of the meshlet cull passes, both phases summed
+    double meshlet_cull_ms = 0.0;
+    // Direct draws recorded per frame and the CPU time spent recording them, zero without --direct-draws
+    bool direct_draws = false;
+    uint32_t direct_draw_count = 0;
+    uint32_t recording_threads = 0;
+    double recording_ms = 0.0;
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include "Types.h"
+#include "StagingRing.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Uploader;
+
+// A set of buffer copies that are recorded into a single command buffer and submitted together. Batches are
+// independent, so several loader threads can fill their own batch at the same time. A batch must always be submitted,
+// since staging ring space it uses stays pinned until then.
+class UploadBatch
+{
+public:
+    // Copies `size` bytes of `data` into staging memory right away, so the caller's memory can be released on return
+    void copy_to_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size);
+    bool empty() const
+    {
+        return m_copies.empty();
+    }
+
+private:
+    friend class Uploader;
+
+    struct Copy
+    {
+        VkBuffer src;
+        VkBuffer dst;
+        VkBufferCopy region;
+        // Only set when the data did not fit into the staging ring and got its own buffer
+        AllocatedBuffer dedicated_staging;
+    };
+
+    Uploader* m_uploader = nullptr;
+    std::vector<Copy> m_copies;
+    uint32_t m_ring_partition_mask = 0;
+};
+
+// Streams data to the GPU on a dedicated transfer queue when the device has one. Submission and retirement happen on
+// a background thread; completion is signaled through a timeline semaphore that frames can wait on, and through the
+// future in the returned UploadTicket.
+class Uploader
+{
+public:
+    void init(VkDevice device,
+              VmaAllocator allocator,
+              StagingRing* staging_ring,
+              uint32_t queue_family_index,
+              VkQueue queue,
+              std::mutex* queue_mutex = nullptr);
+    void destroy();
+
+    UploadBatch begin_batch();
+    UploadTicket submit(UploadBatch&& batch);
+    void wait_idle();
+
+    // True once the batch has been handed to the queue. Only then is it legal for a frame to wait on its value.
+    bool is_submitted(uint64_t value) const;
+    bool is_complete(uint64_t value) const;
+    uint64_t get_completed_value() const;
+
+    VkSemaphore get_timeline_semaphore() const
+    {
+        return m_timeline_semaphore;
+    }
+    uint32_t get_queue_family_index() const
+    {
+        return m_queue_family_index;
+    }
+
+private:
+    friend class UploadBatch;
+
+    struct PendingBatch
+    {
+        uint64_t value = 0;
+        std::vector<UploadBatch::Copy> copies;
+        std::promise<void> completion;
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    };
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+    StagingRing* m_staging_ring = nullptr;
+    uint32_t m_queue_family_index = 0;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    std::mutex* m_queue_mutex = nullptr;
+    VkCommandPool m_command_pool = VK_NULL_HANDLE;
+    VkSemaphore m_timeline_semaphore = VK_NULL_HANDLE;
+
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<PendingBatch> m_queued;
+    bool m_stop = false;
+    uint64_t m_next_value = 1;
+    std::atomic<uint64_t> m_submitted_value = 0;
+
+    AllocatedBuffer create_staging_buffer(VkDeviceSize size);
+    void worker_loop();
+    void submit_batch(PendingBatch& batch);
+    void retire_batch(PendingBatch& batch);
+};
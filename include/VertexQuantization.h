@@ -0,0 +1,27 @@
+#pragma once
+#include "Types.h"
+
+#include <span>
+#include <vector>
+
+namespace vertex_quantization
+{
+    // Bounds of the vertices of each mesh. `vertex_meshes[v]` is the mesh vertex v belongs to; vertices that belong
+    // to no mesh (UINT32_MAX) are skipped.
+    std::vector<MeshQuantization> compute_mesh_quantization(std::span<const Vertex> vertices,
+                                                            std::span<const uint32_t> vertex_meshes,
+                                                            uint32_t mesh_count);
+
+    // Encode every vertex against the bounds of its mesh. Unowned vertices are encoded against mesh 0.
+    void encode(std::span<const Vertex> vertices,
+                std::span<const uint32_t> vertex_meshes,
+                std::span<const MeshQuantization> meshes,
+                std::span<QuantizedVertex> out_vertices);
+
+    // The inverse of encode(), for checking the error of a mesh on the CPU
+    Vertex decode(const QuantizedVertex& vertex, const MeshQuantization& mesh);
+
+    // Unit vector <-> octahedral map in [-1, 1]^2
+    glm::vec2 encode_octahedral(glm::vec3 normal);
+    glm::vec3 decode_octahedral(glm::vec2 encoded);
+} // namespace vertex_quantization
@@ -0,0 +1,191 @@
+#include "Renderer.h"
+#include <cstring>
+#include <cstdlib>
+#include <print>
+
+// Headless frame-throughput benchmark. Renders into the offscreen draw image with no window, surface or present,
+// so it runs on display-less CI machines (e.g. lavapipe).
+// Usage: BikeageBench [--frames N] [--warmup N] [--width W] [--height H] [--scene FILE] [--profile-csv FILE]
+//                     [--instances N] [--frames-in-flight N] [--target-ms MS] [--no-cull] [--no-occlusion]
+//                     [--lod-error PIXELS] [--meshlets] [--async-compute] [--no-descriptor-buffer]
+//                     [--quantized-vertices] [--direct-draws] [--record-threads N] [--validation]
+int main(int argc, char** argv)
+{
+    uint32_t frame_count = 1000;
+    uint32_t warmup_frame_count = 16;
+    const char* profile_csv_path = nullptr;
+    RendererSettings settings = {};
+    settings.headless = true;
+    settings.enable_validation = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--frames") == 0 && has_value)
+        {
+            frame_count = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--warmup") == 0 && has_value)
+        {
+            warmup_frame_count = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--width") == 0 && has_value)
+        {
+            settings.headless_extent.width = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--height") == 0 && has_value)
+        {
+            settings.headless_extent.height = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--scene") == 0 && has_value)
+        {
+            settings.scene_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--profile-csv") == 0 && has_value)
+        {
+            profile_csv_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--instances") == 0 && has_value)
+        {
+            settings.rectangle_instance_count = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--frames-in-flight") == 0 && has_value)
+        {
+            settings.frames_in_flight = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--target-ms") == 0 && has_value)
+        {
+            // Hold this GPU frame time with dynamic resolution
+            settings.dynamic_resolution = true;
+            settings.target_frame_ms = std::strtof(argv[++i], nullptr);
+        }
+        else if (std::strcmp(argv[i], "--no-cull") == 0)
+        {
+            settings.enable_gpu_culling = false;
+        }
+        else if (std::strcmp(argv[i], "--no-occlusion") == 0)
+        {
+            settings.enable_occlusion_culling = false;
+        }
+        else if (std::strcmp(argv[i], "--lod-error") == 0 && has_value)
+        {
+            // 0 draws full detail everywhere
+            settings.lod_error_pixels = std::strtof(argv[++i], nullptr);
+        }
+        else if (std::strcmp(argv[i], "--meshlets") == 0)
+        {
+            settings.meshlet_culling = true;
+        }
+        else if (std::strcmp(argv[i], "--async-compute") == 0)
+        {
+            settings.enable_async_compute = true;
+        }
+        else if (std::strcmp(argv[i], "--no-descriptor-buffer") == 0)
+        {
+            settings.use_descriptor_buffer = false;
+        }
+        else if (std::strcmp(argv[i], "--quantized-vertices") == 0)
+        {
+            settings.quantized_vertices = true;
+        }
+        else if (std::strcmp(argv[i], "--direct-draws") == 0)
+        {
+            settings.direct_draws = true;
+        }
+        else if (std::strcmp(argv[i], "--record-threads") == 0 && has_value)
+        {
+            settings.recording_threads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--validation") == 0)
+        {
+            settings.enable_validation = true;
+        }
+        else
+        {
+            std::println(stderr,
+                         "Usage: {} [--frames N] [--warmup N] [--width W] [--height H] [--scene FILE] "
+                         "[--profile-csv FILE] [--instances N] [--frames-in-flight N] [--target-ms MS] [--no-cull] "
+                         "[--no-occlusion] [--lod-error PIXELS] [--meshlets] [--async-compute] "
+                         "[--no-descriptor-buffer] [--quantized-vertices] [--direct-draws] [--record-threads N] "
+                         "[--validation]",
+                         argv[0]);
+            return 1;
+        }
+    }
+
+    Renderer renderer;
+    renderer.init(settings);
+    BenchmarkResult result = renderer.run_benchmark(frame_count, warmup_frame_count);
+    if (profile_csv_path)
+    {
+        renderer.dump_gpu_profile(profile_csv_path);
+    }
+    renderer.destroy();
+
+    std::println("Frames:        {}", result.frame_count);
+    std::println("Resolution:    {}x{}", settings.headless_extent.width, settings.headless_extent.height);
+    std::println("In flight:     {} frames", result.frames_in_flight);
+    std::println("Render scale:  {:.2f}", result.render_scale);
+    std::println("Total time:    {:.3f} s", result.total_seconds);
+    std::println("Frames/sec:    {:.2f}", result.frames_per_second);
+    std::println("CPU ms/frame:  {:.4f}", result.cpu_ms_per_frame);
+    std::println("GPU ms/frame:  {:.4f}", result.gpu_ms_per_frame);
+    std::println("Draws:         {} ({} drawn, {} frustum culled, {} occlusion culled)",
+                 result.draw_count,
+                 result.drawn_count,
+                 result.frustum_rejected,
+                 result.occlusion_rejected);
+    std::println("Background:    {:.4f} ms on {}",
+                 result.background_ms,
+                 result.async_compute ? "async compute" : "graphics");
+    std::println("GPU passes:    cull {:.4f} ms, geometry {:.4f} ms", result.cull_ms, result.geometry_ms);
+    std::println("Descriptors:   {}", result.descriptor_buffer ? "descriptor buffer" : "descriptor indexing");
+    // Every instance transform is read once by the cull pass, then again per vertex of each drawn instance
+    std::println("Instances:     {} ({:.2f} MB of transforms, {} B each)",
+                 result.instance_count,
+                 result.instance_transform_bytes / (1024.0 * 1024.0),
+                 sizeof(GPUInstanceTransform));
+    std::println("Vertices:      {} ({:.2f} MB, {} B each{})",
+                 result.vertex_count,
+                 result.vertex_bytes / (1024.0 * 1024.0),
+                 result.quantized_vertices ? sizeof(QuantizedVertex) : sizeof(Vertex),
+                 result.quantized_vertices ? ", quantized" : "");
+    std::println("Indices:       {} ({:.2f} MB, {}-bit)",
+                 result.index_count,
+                 result.index_count * result.index_size / (1024.0 * 1024.0),
+                 result.index_size * 8);
+    std::println("LODs:          {} / {} / {} / {} draws, {} triangles",
+                 result.lod_draw_counts[0],
+                 result.lod_draw_counts[1],
+                 result.lod_draw_counts[2],
+                 result.lod_draw_counts[3],
+                 result.drawn_triangle_count);
+    if (result.meshlet_culling)
+    {
+        std::println("Meshlets:      {} tested, {} frustum rejected, {} cone rejected, {} dropped, {:.4f} ms",
+                     result.meshlet_count,
+                     result.meshlet_frustum_rejected,
+                     result.meshlet_cone_rejected,
+                     result.meshlet_overflow,
+                     result.meshlet_cull_ms);
+    }
+    if (result.direct_draws)
+    {
+        std::println("Recording:     {} direct draws in {:.4f} ms on {} threads",
+                     result.direct_draw_count,
+                     result.recording_ms,
+                     result.recording_threads);
+    }
+    std::println("Targets:       {:.2f} MB ({:.2f} MB saved by aliasing)",
+                 result.render_target_bytes / (1024.0 * 1024.0),
+                 result.render_target_saved_bytes / (1024.0 * 1024.0));
+    // Single machine-readable line for CI regression tracking
+    std::println("BENCH frames={} fps={:.2f} cpu_ms={:.4f} gpu_ms={:.4f} cull_ms={:.4f} geometry_ms={:.4f}",
+                 result.frame_count,
+                 result.frames_per_second,
+                 result.cpu_ms_per_frame,
+                 result.gpu_ms_per_frame,
+                 result.cull_ms,
+                 result.geometry_ms);
+    return 0;
+}
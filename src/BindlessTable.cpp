@@ -0,0 +1,300 @@
+#include "BindlessTable.h"
+
+#include <cassert>
+#include <iostream>
+#include <print>
+
+static constexpr std::array<VkDescriptorType, 4> DESCRIPTOR_TYPES = {
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_SAMPLER,
+    VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+};
+
+void BindlessTable::init(VkDevice device,
+                         VkPhysicalDevice physical_device,
+                         VmaAllocator allocator,
+                         bool use_descriptor_buffer)
+{
+    m_device = device;
+    m_allocator = allocator;
+    m_use_descriptor_buffer = use_descriptor_buffer;
+    m_slots[static_cast<uint32_t>(BindlessBinding::SampledImage)].capacity = MAX_SAMPLED_IMAGES;
+    m_slots[static_cast<uint32_t>(BindlessBinding::Sampler)].capacity = MAX_SAMPLERS;
+    m_slots[static_cast<uint32_t>(BindlessBinding::StorageImage)].capacity = MAX_STORAGE_IMAGES;
+    m_slots[static_cast<uint32_t>(BindlessBinding::StorageBuffer)].capacity = MAX_STORAGE_BUFFERS;
+
+    std::array<VkDescriptorSetLayoutBinding, BINDING_COUNT> bindings = {};
+    std::array<VkDescriptorBindingFlags, BINDING_COUNT> binding_flags = {};
+    for (uint32_t binding = 0; binding < BINDING_COUNT; binding++)
+    {
+        bindings[binding].binding = binding;
+        bindings[binding].descriptorType = DESCRIPTOR_TYPES[binding];
+        bindings[binding].descriptorCount = m_slots[binding].capacity;
+        bindings[binding].stageFlags = VK_SHADER_STAGE_ALL;
+        // Descriptor buffers have no notion of updating a bound set, they are plain memory
+        binding_flags[binding] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+        if (!m_use_descriptor_buffer)
+        {
+            binding_flags[binding] |=
+                VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        }
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {};
+    binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    binding_flags_info.pNext = nullptr;
+    binding_flags_info.bindingCount = BINDING_COUNT;
+    binding_flags_info.pBindingFlags = binding_flags.data();
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.pNext = &binding_flags_info;
+    layout_info.flags = m_use_descriptor_buffer ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT
+                                                : VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layout_info.bindingCount = BINDING_COUNT;
+    layout_info.pBindings = bindings.data();
+    VK_CHECK(vkCreateDescriptorSetLayout(m_device, &layout_info, nullptr, &m_layout));
+
+    if (!m_use_descriptor_buffer)
+    {
+        std::array<VkDescriptorPoolSize, BINDING_COUNT> pool_sizes = {};
+        for (uint32_t binding = 0; binding < BINDING_COUNT; binding++)
+        {
+            pool_sizes[binding] = { DESCRIPTOR_TYPES[binding], m_slots[binding].capacity };
+        }
+        VkDescriptorPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.pNext = nullptr;
+        pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        pool_info.maxSets = 1;
+        pool_info.poolSizeCount = BINDING_COUNT;
+        pool_info.pPoolSizes = pool_sizes.data();
+        VK_CHECK(vkCreateDescriptorPool(m_device, &pool_info, nullptr, &m_pool));
+
+        VkDescriptorSetAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.pNext = nullptr;
+        alloc_info.descriptorPool = m_pool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &m_layout;
+        VK_CHECK(vkAllocateDescriptorSets(m_device, &alloc_info, &m_set));
+        std::println("Bindless table: descriptor indexing");
+        return;
+    }
+
+    m_get_layout_size = reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(
+        vkGetDeviceProcAddr(m_device, "vkGetDescriptorSetLayoutSizeEXT"));
+    m_get_binding_offset = reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(
+        vkGetDeviceProcAddr(m_device, "vkGetDescriptorSetLayoutBindingOffsetEXT"));
+    m_get_descriptor =
+        reinterpret_cast<PFN_vkGetDescriptorEXT>(vkGetDeviceProcAddr(m_device, "vkGetDescriptorEXT"));
+    m_cmd_bind_descriptor_buffers = reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(
+        vkGetDeviceProcAddr(m_device, "vkCmdBindDescriptorBuffersEXT"));
+    m_cmd_set_descriptor_buffer_offsets = reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(
+        vkGetDeviceProcAddr(m_device, "vkCmdSetDescriptorBufferOffsetsEXT"));
+
+    VkPhysicalDeviceDescriptorBufferPropertiesEXT descriptor_buffer_properties = {};
+    descriptor_buffer_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &descriptor_buffer_properties;
+    vkGetPhysicalDeviceProperties2(physical_device, &properties);
+    m_slots[static_cast<uint32_t>(BindlessBinding::SampledImage)].descriptor_size =
+        descriptor_buffer_properties.sampledImageDescriptorSize;
+    m_slots[static_cast<uint32_t>(BindlessBinding::Sampler)].descriptor_size =
+        descriptor_buffer_properties.samplerDescriptorSize;
+    m_slots[static_cast<uint32_t>(BindlessBinding::StorageImage)].descriptor_size =
+        descriptor_buffer_properties.storageImageDescriptorSize;
+    m_slots[static_cast<uint32_t>(BindlessBinding::StorageBuffer)].descriptor_size =
+        descriptor_buffer_properties.storageBufferDescriptorSize;
+    for (uint32_t binding = 0; binding < BINDING_COUNT; binding++)
+    {
+        m_get_binding_offset(m_device, m_layout, binding, &m_slots[binding].offset);
+    }
+
+    VkDeviceSize layout_size = 0;
+    m_get_layout_size(m_device, m_layout, &layout_size);
+
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.pNext = nullptr;
+    buffer_info.size = layout_size;
+    buffer_info.usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT |
+                        VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+    VmaAllocationCreateInfo vma_alloc_info = {};
+    vma_alloc_info.usage = VMA_MEMORY_USAGE_AUTO;
+    vma_alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+    VK_CHECK(vmaCreateBuffer(
+        m_allocator, &buffer_info, &vma_alloc_info, &m_buffer.buffer, &m_buffer.allocation, &m_buffer.info));
+
+    VkBufferDeviceAddressInfo address_info = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+                                               .buffer = m_buffer.buffer };
+    m_buffer_address = vkGetBufferDeviceAddress(m_device, &address_info);
+    std::println("Bindless table: descriptor buffer, {} KB", layout_size / 1024);
+}
+
+void BindlessTable::destroy()
+{
+    if (m_buffer.buffer != VK_NULL_HANDLE)
+    {
+        vmaDestroyBuffer(m_allocator, m_buffer.buffer, m_buffer.allocation);
+        m_buffer = {};
+    }
+    if (m_pool != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+        m_pool = VK_NULL_HANDLE;
+        m_set = VK_NULL_HANDLE;
+    }
+    vkDestroyDescriptorSetLayout(m_device, m_layout, nullptr);
+    m_layout = VK_NULL_HANDLE;
+}
+
+uint32_t BindlessTable::add_sampled_image(VkImageView view, VkImageLayout layout)
+{
+    const uint32_t index = allocate_index(BindlessBinding::SampledImage);
+    const VkDescriptorImageInfo image_info = { VK_NULL_HANDLE, view, layout };
+    write(BindlessBinding::SampledImage, index, &image_info, nullptr, 0);
+    return index;
+}
+
+uint32_t BindlessTable::add_sampler(VkSampler sampler)
+{
+    const uint32_t index = allocate_index(BindlessBinding::Sampler);
+    const VkDescriptorImageInfo image_info = { sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+    write(BindlessBinding::Sampler, index, &image_info, nullptr, 0);
+    return index;
+}
+
+uint32_t BindlessTable::add_storage_image(VkImageView view)
+{
+    const uint32_t index = allocate_index(BindlessBinding::StorageImage);
+    const VkDescriptorImageInfo image_info = { VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL };
+    write(BindlessBinding::StorageImage, index, &image_info, nullptr, 0);
+    return index;
+}
+
+uint32_t BindlessTable::add_storage_buffer(VkBuffer buffer, VkDeviceAddress address, VkDeviceSize size)
+{
+    const uint32_t index = allocate_index(BindlessBinding::StorageBuffer);
+    const VkDescriptorBufferInfo buffer_info = { buffer, 0, size };
+    write(BindlessBinding::StorageBuffer, index, nullptr, &buffer_info, address);
+    return index;
+}
+
+void BindlessTable::remove(BindlessBinding binding, uint32_t index)
+{
+    if (index == INVALID_INDEX)
+    {
+        return;
+    }
+    // The slot keeps its stale descriptor; partially bound arrays allow that as long as no shader reads it
+    m_slots[static_cast<uint32_t>(binding)].free.push_back(index);
+}
+
+void BindlessTable::bind(VkCommandBuffer cmd, VkPipelineBindPoint bind_point, VkPipelineLayout layout) const
+{
+    if (!m_use_descriptor_buffer)
+    {
+        vkCmdBindDescriptorSets(cmd, bind_point, layout, 0, 1, &m_set, 0, nullptr);
+        return;
+    }
+    VkDescriptorBufferBindingInfoEXT binding_info = {};
+    binding_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
+    binding_info.pNext = nullptr;
+    binding_info.address = m_buffer_address;
+    binding_info.usage =
+        VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT;
+    m_cmd_bind_descriptor_buffers(cmd, 1, &binding_info);
+
+    const uint32_t buffer_index = 0;
+    const VkDeviceSize offset = 0;
+    m_cmd_set_descriptor_buffer_offsets(cmd, bind_point, layout, 0, 1, &buffer_index, &offset);
+}
+
+uint32_t BindlessTable::get_used_count(BindlessBinding binding) const
+{
+    const Slots& slots = m_slots[static_cast<uint32_t>(binding)];
+    return slots.next - static_cast<uint32_t>(slots.free.size());
+}
+
+uint32_t BindlessTable::allocate_index(BindlessBinding binding)
+{
+    Slots& slots = m_slots[static_cast<uint32_t>(binding)];
+    if (!slots.free.empty())
+    {
+        const uint32_t index = slots.free.back();
+        slots.free.pop_back();
+        return index;
+    }
+    if (slots.next == slots.capacity)
+    {
+        std::cerr << "Bindless table binding " << static_cast<uint32_t>(binding) << " is full" << std::endl;
+        assert(false);
+        return INVALID_INDEX;
+    }
+    return slots.next++;
+}
+
+void BindlessTable::write(BindlessBinding binding,
+                          uint32_t index,
+                          const VkDescriptorImageInfo* image_info,
+                          const VkDescriptorBufferInfo* buffer_info,
+                          VkDeviceAddress buffer_address)
+{
+    if (index == INVALID_INDEX)
+    {
+        return;
+    }
+    const uint32_t binding_index = static_cast<uint32_t>(binding);
+    const VkDescriptorType type = DESCRIPTOR_TYPES[binding_index];
+    if (!m_use_descriptor_buffer)
+    {
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.pNext = nullptr;
+        write.dstSet = m_set;
+        write.dstBinding = binding_index;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = type;
+        write.pImageInfo = image_info;
+        write.pBufferInfo = buffer_info;
+        vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+        return;
+    }
+
+    VkDescriptorAddressInfoEXT address_info = {};
+    address_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT;
+    address_info.pNext = nullptr;
+    VkDescriptorGetInfoEXT get_info = {};
+    get_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+    get_info.pNext = nullptr;
+    get_info.type = type;
+    switch (binding)
+    {
+    case BindlessBinding::SampledImage:
+        get_info.data.pSampledImage = image_info;
+        break;
+    case BindlessBinding::Sampler:
+        get_info.data.pSampler = &image_info->sampler;
+        break;
+    case BindlessBinding::StorageImage:
+        get_info.data.pStorageImage = image_info;
+        break;
+    case BindlessBinding::StorageBuffer:
+        address_info.address = buffer_address;
+        address_info.range = buffer_info->range;
+        address_info.format = VK_FORMAT_UNDEFINED;
+        get_info.data.pStorageBuffer = &address_info;
+        break;
+    }
+
+    const Slots& slots = m_slots[binding_index];
+    const VkDeviceSize offset = slots.offset + index * slots.descriptor_size;
+    m_get_descriptor(
+        m_device, &get_info, slots.descriptor_size, static_cast<uint8_t*>(m_buffer.info.pMappedData) + offset);
+    VK_CHECK(vmaFlushAllocation(m_allocator, m_buffer.allocation, offset, slots.descriptor_size));
+}
@@ -0,0 +1,317 @@
+#include "DepthPyramid.h"
+#include "Initializers.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <bit>
+#include <iostream>
+
+static void pyramid_barrier(VkCommandBuffer cmd,
+                            VkImage image,
+                            uint32_t base_mip,
+                            uint32_t mip_count,
+                            VkAccessFlags2 src_access,
+                            VkAccessFlags2 dst_access)
+{
+    VkImageMemoryBarrier2 image_barrier = {};
+    image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    image_barrier.pNext = nullptr;
+    image_barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    image_barrier.srcAccessMask = src_access;
+    image_barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    image_barrier.dstAccessMask = dst_access;
+    image_barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    image_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    image_barrier.subresourceRange = init::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    image_barrier.subresourceRange.baseMipLevel = base_mip;
+    image_barrier.subresourceRange.levelCount = mip_count;
+    image_barrier.image = image;
+
+    VkDependencyInfo dependency_info{};
+    dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.pNext = nullptr;
+    dependency_info.imageMemoryBarrierCount = 1;
+    dependency_info.pImageMemoryBarriers = &image_barrier;
+
+    vkCmdPipelineBarrier2(cmd, &dependency_info);
+}
+
+void DepthPyramid::init(VkDevice device, VmaAllocator allocator, PipelineCompiler& pipeline_compiler)
+{
+    m_device = device;
+    m_allocator = allocator;
+
+    // Nearest taps only; the cull shader covers the footprint itself
+    VkSamplerCreateInfo sampler_info = {};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.pNext = nullptr;
+    sampler_info.magFilter = VK_FILTER_NEAREST;
+    sampler_info.minFilter = VK_FILTER_NEAREST;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.minLod = 0.0f;
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+    VK_CHECK(vkCreateSampler(m_device, &sampler_info, nullptr, &m_sampler));
+
+    std::array<VkDescriptorSetLayoutBinding, 2> reduce_bindings = {};
+    reduce_bindings[0].binding = 0;
+    reduce_bindings[0].descriptorCount = 1;
+    reduce_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    reduce_bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    reduce_bindings[1].binding = 1;
+    reduce_bindings[1].descriptorCount = 1;
+    reduce_bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    reduce_bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.pNext = nullptr;
+    layout_info.bindingCount = static_cast<uint32_t>(reduce_bindings.size());
+    layout_info.pBindings = reduce_bindings.data();
+    VK_CHECK(vkCreateDescriptorSetLayout(m_device, &layout_info, nullptr, &m_reduce_set_layout));
+
+    VkPushConstantRange push_constant_range = {};
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(ReducePushConstants);
+    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = init::pipeline_layout_create_info();
+    pipeline_layout_info.pSetLayouts = &m_reduce_set_layout;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    VK_CHECK(vkCreatePipelineLayout(m_device, &pipeline_layout_info, nullptr, &m_reduce_pipeline_layout));
+
+    const VkPipelineLayout layout = m_reduce_pipeline_layout;
+    m_reduce_pipeline_job = pipeline_compiler.enqueue(
+        "depth_pyramid",
+        [device, layout](VkPipelineCache pipeline_cache)
+        {
+            VkShaderModule reduce_shader_module = {};
+            if (!util::load_shader_module("shaders/depth_pyramid.comp.spv", device, &reduce_shader_module))
+            {
+                std::cerr << "Failed to load depth pyramid shader" << std::endl;
+                return VkPipeline{ VK_NULL_HANDLE };
+            }
+
+            VkComputePipelineCreateInfo compute_pipeline_create_info = {};
+            compute_pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            compute_pipeline_create_info.pNext = nullptr;
+            compute_pipeline_create_info.layout = layout;
+            compute_pipeline_create_info.stage =
+                init::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, reduce_shader_module);
+
+            VkPipeline pipeline = VK_NULL_HANDLE;
+            VK_CHECK(
+                vkCreateComputePipelines(device, pipeline_cache, 1, &compute_pipeline_create_info, nullptr, &pipeline));
+
+            vkDestroyShaderModule(device, reduce_shader_module, nullptr);
+            return pipeline;
+        });
+}
+
+void DepthPyramid::destroy()
+{
+    destroy_image();
+    vkDestroyPipeline(m_device, m_reduce_pipeline_job.get(), nullptr);
+    vkDestroyPipelineLayout(m_device, m_reduce_pipeline_layout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_reduce_set_layout, nullptr);
+    vkDestroySampler(m_device, m_sampler, nullptr);
+}
+
+void DepthPyramid::create(VkImageView depth_view, VkExtent2D depth_extent)
+{
+    destroy_image();
+
+    m_depth_view = depth_view;
+    m_depth_extent = depth_extent;
+    m_extent = pyramid_extent(depth_extent);
+    m_mip_count = std::min<uint32_t>(std::bit_width(std::max(m_extent.width, m_extent.height)), MAX_MIP_COUNT);
+
+    VkImageCreateInfo image_info = init::image_create_info(VK_FORMAT_R32_SFLOAT,
+                                                           VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+                                                           { m_extent.width, m_extent.height, 1 });
+    image_info.mipLevels = m_mip_count;
+
+    VmaAllocationCreateInfo alloc_info = {};
+    alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    alloc_info.requiredFlags = static_cast<VkMemoryPropertyFlags>(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_CHECK(vmaCreateImage(m_allocator, &image_info, &alloc_info, &m_image, &m_allocation, nullptr));
+
+    VkImageViewCreateInfo view_info =
+        init::image_view_create_info(VK_FORMAT_R32_SFLOAT, m_image, VK_IMAGE_ASPECT_COLOR_BIT);
+    view_info.subresourceRange.levelCount = m_mip_count;
+    VK_CHECK(vkCreateImageView(m_device, &view_info, nullptr, &m_view));
+    for (uint32_t mip = 0; mip < m_mip_count; mip++)
+    {
+        view_info.subresourceRange.baseMipLevel = mip;
+        view_info.subresourceRange.levelCount = 1;
+        VK_CHECK(vkCreateImageView(m_device, &view_info, nullptr, &m_mip_views[mip]));
+    }
+
+    m_valid = false;
+}
+
+void DepthPyramid::destroy_image()
+{
+    if (m_image == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    for (uint32_t mip = 0; mip < m_mip_count; mip++)
+    {
+        vkDestroyImageView(m_device, m_mip_views[mip], nullptr);
+        m_mip_views[mip] = VK_NULL_HANDLE;
+    }
+    vkDestroyImageView(m_device, m_view, nullptr);
+    vmaDestroyImage(m_allocator, m_image, m_allocation);
+    m_image = VK_NULL_HANDLE;
+    m_depth_view = VK_NULL_HANDLE;
+    m_view = VK_NULL_HANDLE;
+    m_mip_count = 0;
+    m_valid = false;
+}
+
+void DepthPyramid::resize(VkImageView depth_view, VkExtent2D depth_extent, TimelineDeletionQueue& deletion_queue)
+{
+    const VkExtent2D extent = pyramid_extent(depth_extent);
+    if (m_image != VK_NULL_HANDLE && depth_view == m_depth_view && extent.width == m_extent.width &&
+        extent.height == m_extent.height)
+    {
+        // Only the reduced region changed
+        m_depth_extent = depth_extent;
+        m_valid = false;
+        return;
+    }
+
+    if (m_image != VK_NULL_HANDLE)
+    {
+        std::array<VkImageView, MAX_MIP_COUNT + 1> views = {};
+        std::copy_n(m_mip_views.begin(), m_mip_count, views.begin());
+        views[m_mip_count] = m_view;
+        deletion_queue.push_function(
+            [device = m_device,
+             allocator = m_allocator,
+             image = m_image,
+             allocation = m_allocation,
+             views,
+             view_count = m_mip_count + 1]()
+            {
+                for (uint32_t i = 0; i < view_count; i++)
+                {
+                    vkDestroyImageView(device, views[i], nullptr);
+                }
+                vmaDestroyImage(allocator, image, allocation);
+            });
+        m_image = VK_NULL_HANDLE;
+    }
+    create(depth_view, depth_extent);
+}
+
+VkExtent2D DepthPyramid::pyramid_extent(VkExtent2D depth_extent)
+{
+    return { std::bit_floor(std::max(depth_extent.width, 1u)), std::bit_floor(std::max(depth_extent.height, 1u)) };
+}
+
+bool DepthPyramid::is_ready()
+{
+    if (m_reduce_pipeline == VK_NULL_HANDLE)
+    {
+        m_reduce_pipeline = m_reduce_pipeline_job.try_get();
+    }
+    return m_reduce_pipeline != VK_NULL_HANDLE && m_image != VK_NULL_HANDLE;
+}
+
+bool DepthPyramid::build(VkCommandBuffer cmd, DescriptorAllocator& descriptor_allocator)
+{
+    if (!is_ready())
+    {
+        return false;
+    }
+
+    // One reduce set per level reading the level above it (the depth image for level 0). They only live for the
+    // frame, so a resized pyramid has no sets to retire.
+    std::array<VkDescriptorSet, MAX_MIP_COUNT> reduce_sets = {};
+    std::array<VkDescriptorImageInfo, MAX_MIP_COUNT * 2> image_infos = {};
+    std::array<VkWriteDescriptorSet, MAX_MIP_COUNT * 2> writes = {};
+    uint32_t write_count = 0;
+    auto add_write =
+        [&](VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkImageView view, VkImageLayout layout)
+    {
+        image_infos[write_count] = { m_sampler, view, layout };
+        VkWriteDescriptorSet& write = writes[write_count];
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = binding;
+        write.dstArrayElement = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = type;
+        write.pImageInfo = &image_infos[write_count];
+        write_count++;
+    };
+    for (uint32_t mip = 0; mip < m_mip_count; mip++)
+    {
+        reduce_sets[mip] = descriptor_allocator.allocate(m_reduce_set_layout);
+        if (mip == 0)
+        {
+            add_write(reduce_sets[mip],
+                      0,
+                      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                      m_depth_view,
+                      VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+        }
+        else
+        {
+            add_write(reduce_sets[mip],
+                      0,
+                      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                      m_mip_views[mip - 1],
+                      VK_IMAGE_LAYOUT_GENERAL);
+        }
+        add_write(reduce_sets[mip], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, m_mip_views[mip], VK_IMAGE_LAYOUT_GENERAL);
+    }
+    vkUpdateDescriptorSets(m_device, write_count, writes.data(), 0, nullptr);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_reduce_pipeline);
+    VkExtent2D source_extent = m_depth_extent;
+    for (uint32_t mip = 0; mip < m_mip_count; mip++)
+    {
+        const VkExtent2D mip_extent = { std::max(m_extent.width >> mip, 1u), std::max(m_extent.height >> mip, 1u) };
+        vkCmdBindDescriptorSets(cmd,
+                                VK_PIPELINE_BIND_POINT_COMPUTE,
+                                m_reduce_pipeline_layout,
+                                0,
+                                1,
+                                &reduce_sets[mip],
+                                0,
+                                nullptr);
+        const ReducePushConstants push_constants = {
+            source_extent.width, source_extent.height, mip_extent.width, mip_extent.height
+        };
+        vkCmdPushConstants(cmd,
+                           m_reduce_pipeline_layout,
+                           VK_SHADER_STAGE_COMPUTE_BIT,
+                           0,
+                           sizeof(ReducePushConstants),
+                           &push_constants);
+        vkCmdDispatch(cmd, (mip_extent.width + 7) / 8, (mip_extent.height + 7) / 8, 1);
+
+        // The next level reads this one; the last level is handed over by whoever declared the pyramid's readers
+        if (mip + 1 == m_mip_count)
+        {
+            break;
+        }
+        pyramid_barrier(cmd,
+                        m_image,
+                        mip,
+                        1,
+                        VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                        VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+        source_extent = mip_extent;
+    }
+
+    m_valid = true;
+    return true;
+}
@@ -0,0 +1,107 @@
+#include "DescriptorAllocator.h"
+#include "Types.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+void DescriptorAllocator::init(VkDevice device, uint32_t initial_sets, std::span<const DescriptorPoolSizeRatio> ratios)
+{
+    m_device = device;
+    m_ratios.assign(ratios.begin(), ratios.end());
+    m_sets_per_pool = std::max(initial_sets, 1u);
+    m_ready_pools.push_back(create_pool(m_sets_per_pool));
+}
+
+void DescriptorAllocator::destroy()
+{
+    for (VkDescriptorPool pool : m_ready_pools)
+    {
+        vkDestroyDescriptorPool(m_device, pool, nullptr);
+    }
+    for (VkDescriptorPool pool : m_full_pools)
+    {
+        vkDestroyDescriptorPool(m_device, pool, nullptr);
+    }
+    m_ready_pools.clear();
+    m_full_pools.clear();
+}
+
+void DescriptorAllocator::reset()
+{
+    for (VkDescriptorPool pool : m_ready_pools)
+    {
+        VK_CHECK(vkResetDescriptorPool(m_device, pool, 0));
+    }
+    for (VkDescriptorPool pool : m_full_pools)
+    {
+        VK_CHECK(vkResetDescriptorPool(m_device, pool, 0));
+        m_ready_pools.push_back(pool);
+    }
+    m_full_pools.clear();
+    m_last_set_count = m_set_count;
+    m_set_count = 0;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.pNext = nullptr;
+    alloc_info.descriptorPool = get_pool();
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &layout;
+
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    const VkResult alloc_result = vkAllocateDescriptorSets(m_device, &alloc_info, &set);
+    if (alloc_result == VK_ERROR_OUT_OF_POOL_MEMORY || alloc_result == VK_ERROR_FRAGMENTED_POOL)
+    {
+        // Retire the exhausted pool and retry once from a fresh one, which always has room for a single set
+        m_full_pools.push_back(m_ready_pools.back());
+        m_ready_pools.pop_back();
+        alloc_info.descriptorPool = get_pool();
+        VK_CHECK(vkAllocateDescriptorSets(m_device, &alloc_info, &set));
+    }
+    else
+    {
+        VK_CHECK(alloc_result);
+    }
+    m_set_count++;
+    m_total_set_count++;
+    return set;
+}
+
+VkDescriptorPool DescriptorAllocator::create_pool(uint32_t set_count) const
+{
+    std::vector<VkDescriptorPoolSize> pool_sizes;
+    pool_sizes.reserve(m_ratios.size());
+    for (const DescriptorPoolSizeRatio& ratio : m_ratios)
+    {
+        const uint32_t count = std::max(static_cast<uint32_t>(ratio.ratio * set_count), 1u);
+        pool_sizes.push_back({ ratio.type, count });
+    }
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.pNext = nullptr;
+    pool_info.flags = 0;
+    pool_info.maxSets = set_count;
+    pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+    pool_info.pPoolSizes = pool_sizes.data();
+
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateDescriptorPool(m_device, &pool_info, nullptr, &pool));
+    return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::get_pool()
+{
+    if (!m_ready_pools.empty())
+    {
+        return m_ready_pools.back();
+    }
+    // Only grows when a frame outran every pool it had, so the chain settles after a few frames
+    m_sets_per_pool = std::min(m_sets_per_pool + std::max(m_sets_per_pool / 2, 1u), MAX_SETS_PER_POOL);
+    m_ready_pools.push_back(create_pool(m_sets_per_pool));
+    return m_ready_pools.back();
+}
@@ -0,0 +1,82 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+void DynamicResolution::set_scale_range(float min_scale, float max_scale)
+{
+    m_min_scale = std::clamp(min_scale, 0.1f, 1.0f);
+    m_max_scale = std::clamp(max_scale, m_min_scale, 1.0f);
+    m_scale = std::clamp(m_scale, m_min_scale, m_max_scale);
+}
+
+bool DynamicResolution::update(double gpu_ms)
+{
+    if (m_settle_frames > 0)
+    {
+        m_settle_frames--;
+        return false;
+    }
+    if (gpu_ms <= 0.0 || m_target_ms <= 0.0)
+    {
+        return false;
+    }
+
+    const float old_scale = m_scale;
+    const double ratio = gpu_ms / m_target_ms;
+    if (ratio > 1.0)
+    {
+        m_headroom_frames = 0;
+        m_over_budget_frames++;
+        if (ratio > SPIKE_RATIO || m_over_budget_frames >= OVER_BUDGET_FRAMES)
+        {
+            // Cost follows the pixel count, so each side shrinks by the square root, aiming a little under budget
+            set_scale(m_scale * static_cast<float>(std::sqrt(0.95 / ratio)));
+        }
+    }
+    else if (ratio < HEADROOM_RATIO)
+    {
+        m_over_budget_frames = 0;
+        m_headroom_frames++;
+        if (m_headroom_frames >= HEADROOM_FRAMES)
+        {
+            set_scale(m_scale * std::min(static_cast<float>(std::sqrt(HEADROOM_RATIO / ratio)), MAX_STEP_UP));
+        }
+    }
+    else
+    {
+        m_over_budget_frames = 0;
+        m_headroom_frames = 0;
+    }
+    return m_scale != old_scale;
+}
+
+void DynamicResolution::reset()
+{
+    m_scale = m_max_scale;
+    m_settle_frames = 0;
+    m_over_budget_frames = 0;
+    m_headroom_frames = 0;
+}
+
+VkExtent2D DynamicResolution::scale_extent(VkExtent2D extent) const
+{
+    auto scale_side = [this](uint32_t side)
+    {
+        const uint32_t scaled = static_cast<uint32_t>(std::lround(side * m_scale));
+        return std::clamp((scaled + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE, std::min(side, TILE_SIZE), side);
+    };
+    return { scale_side(extent.width), scale_side(extent.height) };
+}
+
+void DynamicResolution::set_scale(float scale)
+{
+    scale = std::clamp(scale, m_min_scale, m_max_scale);
+    m_over_budget_frames = 0;
+    m_headroom_frames = 0;
+    if (scale != m_scale)
+    {
+        m_scale = scale;
+        m_settle_frames = m_latency_frames;
+    }
+}
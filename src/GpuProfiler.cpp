@@ -0,0 +1,302 @@
+#include "GpuProfiler.h"
+#include "imgui.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+static constexpr uint32_t INVALID_SCOPE = UINT32_MAX;
+
+void GpuProfiler::PassStats::add_sample(double ms)
+{
+    last_ms = ms;
+    history[history_head] = ms;
+    history_head = (history_head + 1) % HISTORY_SIZE;
+    history_count = std::min(history_count + 1, HISTORY_SIZE);
+}
+
+double GpuProfiler::PassStats::average() const
+{
+    if (history_count == 0)
+    {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (size_t i = 0; i < history_count; i++)
+    {
+        sum += history[i];
+    }
+    return sum / static_cast<double>(history_count);
+}
+
+double GpuProfiler::PassStats::percentile(double p) const
+{
+    if (history_count == 0)
+    {
+        return 0.0;
+    }
+    std::vector<double> sorted(history.begin(), history.begin() + history_count);
+    const size_t rank = std::min(static_cast<size_t>(p / 100.0 * static_cast<double>(history_count)), history_count - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+double GpuProfiler::PassStats::max() const
+{
+    if (history_count == 0)
+    {
+        return 0.0;
+    }
+    return *std::max_element(history.begin(), history.begin() + history_count);
+}
+
+void GpuProfiler::init(VkDevice device,
+                       VkPhysicalDevice physical_device,
+                       uint32_t queue_family_index,
+                       uint32_t frame_count)
+{
+    m_device = device;
+
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    m_ns_per_tick = properties.limits.timestampPeriod;
+
+    uint32_t queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families.data());
+
+    const uint32_t valid_bits = queue_families[queue_family_index].timestampValidBits;
+    if (valid_bits == 0)
+    {
+        std::cerr << "Timestamp queries are not supported on the graphics queue, GPU profiling disabled" << std::endl;
+        m_enabled = false;
+        return;
+    }
+    m_valid_bits_mask = valid_bits >= 64 ? ~0ull : ((1ull << valid_bits) - 1);
+    m_enabled = true;
+
+    VkQueryPoolCreateInfo query_pool_info = {};
+    query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_info.pNext = nullptr;
+    query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_info.queryCount = MAX_SCOPES_PER_FRAME * 2;
+
+    m_frames.resize(frame_count);
+    for (FrameQueries& frame : m_frames)
+    {
+        if (vkCreateQueryPool(m_device, &query_pool_info, nullptr, &frame.query_pool) != VK_SUCCESS)
+        {
+            std::cerr << "Failed to create timestamp query pool, GPU profiling disabled" << std::endl;
+            m_enabled = false;
+        }
+        frame.scope_names.reserve(MAX_SCOPES_PER_FRAME);
+    }
+}
+
+void GpuProfiler::destroy()
+{
+    for (FrameQueries& frame : m_frames)
+    {
+        vkDestroyQueryPool(m_device, frame.query_pool, nullptr);
+    }
+    m_frames.clear();
+    m_enabled = false;
+}
+
+bool GpuProfiler::collect(uint32_t frame_slot)
+{
+    if (!m_enabled)
+    {
+        return false;
+    }
+
+    FrameQueries& frame = m_frames[frame_slot];
+    if (!frame.pending || frame.scope_names.empty())
+    {
+        return false;
+    }
+    frame.pending = false;
+
+    // Each query is followed by its availability word. This frame's timeline value has already completed, so no
+    // VK_QUERY_RESULT_WAIT_BIT is needed and anything unavailable is simply skipped.
+    const uint32_t query_count = static_cast<uint32_t>(frame.scope_names.size()) * 2;
+    std::array<uint64_t, MAX_SCOPES_PER_FRAME * 2 * 2> results = {};
+    VkResult result = vkGetQueryPoolResults(m_device,
+                                            frame.query_pool,
+                                            0,
+                                            query_count,
+                                            query_count * 2 * sizeof(uint64_t),
+                                            results.data(),
+                                            2 * sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY)
+    {
+        return false;
+    }
+
+    m_collect_count++;
+    for (size_t i = 0; i < frame.scope_names.size(); i++)
+    {
+        const uint64_t begin = results[i * 4 + 0] & m_valid_bits_mask;
+        const bool begin_available = results[i * 4 + 1] != 0;
+        const uint64_t end = results[i * 4 + 2] & m_valid_bits_mask;
+        const bool end_available = results[i * 4 + 3] != 0;
+        if (!begin_available || !end_available || end < begin)
+        {
+            continue;
+        }
+        const double ms = static_cast<double>(end - begin) * m_ns_per_tick / 1'000'000.0;
+        PassStats& stats = find_or_add_stats(frame.scope_names[i]);
+        stats.add_sample(ms);
+        stats.last_collect = m_collect_count;
+    }
+    return true;
+}
+
+void GpuProfiler::begin_frame(VkCommandBuffer cmd, uint32_t frame_slot)
+{
+    m_current_slot = frame_slot;
+    if (!m_enabled)
+    {
+        return;
+    }
+    FrameQueries& frame = m_frames[frame_slot];
+    frame.scope_names.clear();
+    frame.pending = true;
+    vkCmdResetQueryPool(cmd, frame.query_pool, 0, MAX_SCOPES_PER_FRAME * 2);
+}
+
+uint32_t GpuProfiler::begin_scope(VkCommandBuffer cmd, const char* name)
+{
+    if (!m_enabled)
+    {
+        return INVALID_SCOPE;
+    }
+    FrameQueries& frame = m_frames[m_current_slot];
+    if (frame.scope_names.size() >= MAX_SCOPES_PER_FRAME)
+    {
+        return INVALID_SCOPE;
+    }
+    const uint32_t scope_index = static_cast<uint32_t>(frame.scope_names.size());
+    frame.scope_names.push_back(name);
+    // ALL_COMMANDS makes the begin timestamp wait for the preceding work, so passes are not double counted
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.query_pool, scope_index * 2);
+    return scope_index;
+}
+
+void GpuProfiler::end_scope(VkCommandBuffer cmd, uint32_t scope_index)
+{
+    if (!m_enabled || scope_index == INVALID_SCOPE)
+    {
+        return;
+    }
+    vkCmdWriteTimestamp2(
+        cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_frames[m_current_slot].query_pool, scope_index * 2 + 1);
+}
+
+double GpuProfiler::get_last_ms(const char* name) const
+{
+    for (const PassStats& stats : m_stats)
+    {
+        if (stats.name == name)
+        {
+            return stats.last_ms;
+        }
+    }
+    return 0.0;
+}
+
+bool GpuProfiler::get_collected_ms(const char* name, double& ms) const
+{
+    for (const PassStats& stats : m_stats)
+    {
+        if (stats.name == name)
+        {
+            if (m_collect_count == 0 || stats.last_collect != m_collect_count)
+            {
+                return false;
+            }
+            ms = stats.last_ms;
+            return true;
+        }
+    }
+    return false;
+}
+
+GpuProfiler::PassStats& GpuProfiler::find_or_add_stats(const char* name)
+{
+    for (PassStats& stats : m_stats)
+    {
+        if (stats.name == name)
+        {
+            return stats;
+        }
+    }
+    PassStats& stats = m_stats.emplace_back();
+    stats.name = name;
+    return stats;
+}
+
+void GpuProfiler::draw_imgui_panel()
+{
+    if (ImGui::Begin("GPU Profiler"))
+    {
+        if (!m_enabled)
+        {
+            ImGui::TextUnformatted("Timestamp queries unavailable");
+        }
+        else if (ImGui::BeginTable("gpu_passes", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Pass");
+            ImGui::TableSetupColumn("Last ms");
+            ImGui::TableSetupColumn("Avg ms");
+            ImGui::TableSetupColumn("P50 ms");
+            ImGui::TableSetupColumn("P95 ms");
+            ImGui::TableSetupColumn("P99 ms");
+            ImGui::TableHeadersRow();
+            for (const PassStats& stats : m_stats)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(stats.name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", stats.last_ms);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", stats.average());
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", stats.percentile(50.0));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", stats.percentile(95.0));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", stats.percentile(99.0));
+            }
+            ImGui::EndTable();
+        }
+
+        if (ImGui::Button("Dump CSV"))
+        {
+            dump_csv("gpu_profile.csv");
+        }
+    }
+    ImGui::End();
+}
+
+bool GpuProfiler::dump_csv(const char* file_path) const
+{
+    std::ofstream file(file_path);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open " << file_path << " for writing" << std::endl;
+        return false;
+    }
+
+    file << "pass,samples,last_ms,avg_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+    for (const PassStats& stats : m_stats)
+    {
+        file << stats.name << ',' << stats.history_count << ',' << stats.last_ms << ',' << stats.average() << ','
+             << stats.percentile(50.0) << ',' << stats.percentile(95.0) << ',' << stats.percentile(99.0) << ','
+             << stats.max() << '\n';
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+#include "GpuTimeline.h"
+#include "Initializers.h"
+
+void GpuTimeline::init(VkDevice device)
+{
+    m_device = device;
+
+    VkSemaphoreTypeCreateInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timeline_info.pNext = nullptr;
+    timeline_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timeline_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphore_info = init::semaphore_create_info();
+    semaphore_info.pNext = &timeline_info;
+    VK_CHECK(vkCreateSemaphore(m_device, &semaphore_info, nullptr, &m_semaphore));
+    m_submitted_value = 0;
+}
+
+void GpuTimeline::destroy()
+{
+    vkDestroySemaphore(m_device, m_semaphore, nullptr);
+    m_semaphore = VK_NULL_HANDLE;
+}
+
+uint64_t GpuTimeline::next_value()
+{
+    return m_submitted_value.fetch_add(1, std::memory_order_acq_rel) + 1;
+}
+
+VkSemaphoreSubmitInfo GpuTimeline::signal_info(uint64_t value, VkPipelineStageFlags2 stage) const
+{
+    VkSemaphoreSubmitInfo info = init::semaphore_submit_info(stage, m_semaphore);
+    info.value = value;
+    return info;
+}
+
+uint64_t GpuTimeline::get_completed_value() const
+{
+    uint64_t completed_value = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_semaphore, &completed_value));
+    return completed_value;
+}
+
+VkResult GpuTimeline::wait(uint64_t value, uint64_t timeout) const
+{
+    if (value == 0)
+    {
+        return VK_SUCCESS;
+    }
+    VkSemaphoreWaitInfo wait_info = {};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.pNext = nullptr;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &m_semaphore;
+    wait_info.pValues = &value;
+    return vkWaitSemaphores(m_device, &wait_info, timeout);
+}
@@ -0,0 +1,369 @@
+#include "MeshCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <print>
+#include <type_traits>
+
+static constexpr uint32_t MESH_CACHE_MAGIC = 0x434D4B42; // "BKMC"
+static constexpr uint32_t MESH_CACHE_VERSION = 6;
+// Sections start on this boundary so the mapped arrays can be read in place
+static constexpr uint64_t MESH_CACHE_SECTION_ALIGNMENT = 64;
+
+enum MeshCacheSection : uint32_t
+{
+    SECTION_VERTICES,
+    SECTION_INDICES,
+    SECTION_INSTANCE_TRANSFORMS,
+    SECTION_INSTANCE_MESHES,
+    SECTION_PRIMITIVES,
+    SECTION_MESHES,
+    SECTION_NAMES,
+    SECTION_MESHLETS,
+    SECTION_COUNT
+};
+
+struct MeshCacheSectionRange
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct MeshCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_stride;
+    uint32_t section_count;
+    uint64_t source_size;
+    int64_t source_write_time;
+    uint64_t source_hash;
+    MeshCacheSectionRange sections[SECTION_COUNT];
+};
+
+struct MeshCacheMeshRecord
+{
+    uint32_t first_primitive;
+    uint32_t primitive_count;
+    uint32_t name_offset;
+    uint32_t name_size;
+};
+
+static_assert(std::is_trivially_copyable_v<Vertex> && std::is_trivially_copyable_v<ScenePrimitive> &&
+              std::is_trivially_copyable_v<GPUInstanceTransform> && std::is_trivially_copyable_v<GPUMeshlet>);
+
+static uint64_t hash_bytes(const std::byte* data, size_t size)
+{
+    // FNV-1a over 64-bit words with an extra shift to fold the high bits back in, then the tail byte by byte
+    constexpr uint64_t prime = 0x100000001b3ull;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(uint64_t));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++)
+    {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * prime;
+    }
+    return hash;
+}
+
+static int64_t file_write_time(const std::filesystem::path& file_path)
+{
+    std::error_code error;
+    const auto write_time = std::filesystem::last_write_time(file_path, error);
+    return error ? 0 : static_cast<int64_t>(write_time.time_since_epoch().count());
+}
+
+template <typename T>
+static bool map_section(const MappedFile& file,
+                        const MeshCacheSectionRange& range,
+                        std::span<const T>& out_span)
+{
+    if (range.size % sizeof(T) != 0 || range.offset % alignof(T) != 0 || range.offset > file.size() ||
+        range.size > file.size() - range.offset)
+    {
+        return false;
+    }
+    out_span = { reinterpret_cast<const T*>(file.data() + range.offset), range.size / sizeof(T) };
+    return true;
+}
+
+// The renderer indexes the arrays with these values unchecked, so a corrupt or stale file must not get past open()
+static bool validate_ranges(const SceneView& scene)
+{
+    if (scene.instance_meshes.size() != scene.instance_transforms.size())
+    {
+        return false;
+    }
+    for (uint32_t mesh : scene.instance_meshes)
+    {
+        if (mesh >= scene.meshes.size())
+        {
+            return false;
+        }
+    }
+    for (const SceneMesh& mesh : scene.meshes)
+    {
+        if (static_cast<uint64_t>(mesh.first_primitive) + mesh.primitive_count > scene.primitives.size())
+        {
+            return false;
+        }
+    }
+    for (const ScenePrimitive& primitive : scene.primitives)
+    {
+        if (primitive.vertex_offset < 0 || primitive.lod_count == 0 || primitive.lod_count > MAX_MESH_LODS)
+        {
+            return false;
+        }
+        for (const GPUMeshLod& lod : std::span(primitive.lods).first(primitive.lod_count))
+        {
+            if (static_cast<uint64_t>(lod.first_index) + lod.index_count > scene.indices.size() ||
+                static_cast<uint64_t>(lod.first_meshlet) + lod.meshlet_count > scene.meshlets.size())
+            {
+                return false;
+            }
+            for (uint32_t index : scene.indices.subspan(lod.first_index, lod.index_count))
+            {
+                if (static_cast<uint64_t>(primitive.vertex_offset) + index >= scene.vertices.size())
+                {
+                    return false;
+                }
+            }
+            for (const GPUMeshlet& meshlet : scene.meshlets.subspan(lod.first_meshlet, lod.meshlet_count))
+            {
+                if (static_cast<uint64_t>(meshlet.first_index) + meshlet.triangle_count * 3ull > lod.index_count)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool CookedScene::open(const std::filesystem::path& cooked_path)
+{
+    close();
+    if (!m_file.open(cooked_path))
+    {
+        return false;
+    }
+
+    MeshCacheHeader header = {};
+    if (m_file.size() < sizeof(MeshCacheHeader))
+    {
+        close();
+        return false;
+    }
+    memcpy(&header, m_file.data(), sizeof(MeshCacheHeader));
+    if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION ||
+        header.vertex_stride != sizeof(Vertex) || header.section_count != SECTION_COUNT)
+    {
+        close();
+        return false;
+    }
+
+    std::span<const MeshCacheMeshRecord> mesh_records;
+    std::span<const char> names;
+    if (!map_section(m_file, header.sections[SECTION_VERTICES], m_vertices) ||
+        !map_section(m_file, header.sections[SECTION_INDICES], m_indices) ||
+        !map_section(m_file, header.sections[SECTION_INSTANCE_TRANSFORMS], m_instance_transforms) ||
+        !map_section(m_file, header.sections[SECTION_INSTANCE_MESHES], m_instance_meshes) ||
+        !map_section(m_file, header.sections[SECTION_PRIMITIVES], m_primitives) ||
+        !map_section(m_file, header.sections[SECTION_MESHES], mesh_records) ||
+        !map_section(m_file, header.sections[SECTION_NAMES], names) ||
+        !map_section(m_file, header.sections[SECTION_MESHLETS], m_meshlets))
+    {
+        std::cerr << "Cooked mesh file " << cooked_path << " is truncated" << std::endl;
+        close();
+        return false;
+    }
+
+    // Mesh tables are tiny, names are copied out so SceneMesh keeps owning its strings
+    m_meshes.reserve(mesh_records.size());
+    for (const MeshCacheMeshRecord& record : mesh_records)
+    {
+        if (static_cast<uint64_t>(record.name_offset) + record.name_size > names.size())
+        {
+            close();
+            return false;
+        }
+        m_meshes.push_back({ std::string(names.data() + record.name_offset, record.name_size),
+                             record.first_primitive,
+                             record.primitive_count });
+    }
+
+    if (!validate_ranges(view()))
+    {
+        std::cerr << "Cooked mesh file " << cooked_path << " has out of range indices" << std::endl;
+        close();
+        return false;
+    }
+
+    m_source_size = header.source_size;
+    m_source_write_time = header.source_write_time;
+    m_source_hash = header.source_hash;
+    return true;
+}
+
+void CookedScene::close()
+{
+    m_file.close();
+    m_vertices = {};
+    m_indices = {};
+    m_instance_transforms = {};
+    m_instance_meshes = {};
+    m_primitives = {};
+    m_meshlets = {};
+    m_meshes.clear();
+    m_source_size = 0;
+    m_source_write_time = 0;
+    m_source_hash = 0;
+}
+
+SceneView CookedScene::view() const
+{
+    return { m_vertices, m_indices, m_meshes, m_primitives, m_instance_transforms, m_instance_meshes, m_meshlets };
+}
+
+namespace mesh_cache
+{
+    std::filesystem::path cooked_path_for(const std::filesystem::path& source_path)
+    {
+        std::filesystem::path cooked_path = source_path;
+        cooked_path += ".bkmesh";
+        return cooked_path;
+    }
+
+    uint64_t hash_file(const std::filesystem::path& file_path)
+    {
+        MappedFile file;
+        if (!file.open(file_path))
+        {
+            return 0;
+        }
+        return hash_bytes(file.data(), file.size());
+    }
+
+    bool is_up_to_date(const CookedScene& cooked, const std::filesystem::path& source_path)
+    {
+        std::error_code error;
+        const uint64_t source_size = std::filesystem::file_size(source_path, error);
+        if (error || source_size != cooked.get_source_size())
+        {
+            return false;
+        }
+        if (file_write_time(source_path) == cooked.get_source_write_time())
+        {
+            return true;
+        }
+        return hash_file(source_path) == cooked.get_source_hash();
+    }
+
+    bool write(const SceneData& scene, const std::filesystem::path& source_path, const std::filesystem::path& cooked_path)
+    {
+        std::vector<MeshCacheMeshRecord> mesh_records;
+        std::string names;
+        mesh_records.reserve(scene.meshes.size());
+        for (const SceneMesh& mesh : scene.meshes)
+        {
+            mesh_records.push_back({ mesh.first_primitive,
+                                     mesh.primitive_count,
+                                     static_cast<uint32_t>(names.size()),
+                                     static_cast<uint32_t>(mesh.name.size()) });
+            names += mesh.name;
+        }
+
+        const std::pair<const void*, uint64_t> payloads[SECTION_COUNT] = {
+            { scene.vertices.data(), scene.vertices.size() * sizeof(Vertex) },
+            { scene.indices.data(), scene.indices.size() * sizeof(uint32_t) },
+            { scene.instance_transforms.data(), scene.instance_transforms.size() * sizeof(GPUInstanceTransform) },
+            { scene.instance_meshes.data(), scene.instance_meshes.size() * sizeof(uint32_t) },
+            { scene.primitives.data(), scene.primitives.size() * sizeof(ScenePrimitive) },
+            { mesh_records.data(), mesh_records.size() * sizeof(MeshCacheMeshRecord) },
+            { names.data(), names.size() },
+            { scene.meshlets.data(), scene.meshlets.size() * sizeof(GPUMeshlet) },
+        };
+
+        std::error_code error;
+        MeshCacheHeader header = {};
+        header.magic = MESH_CACHE_MAGIC;
+        header.version = MESH_CACHE_VERSION;
+        header.vertex_stride = sizeof(Vertex);
+        header.section_count = SECTION_COUNT;
+        header.source_size = std::filesystem::file_size(source_path, error);
+        header.source_write_time = file_write_time(source_path);
+        header.source_hash = hash_file(source_path);
+
+        uint64_t offset = sizeof(MeshCacheHeader);
+        for (uint32_t i = 0; i < SECTION_COUNT; i++)
+        {
+            offset = (offset + MESH_CACHE_SECTION_ALIGNMENT - 1) & ~(MESH_CACHE_SECTION_ALIGNMENT - 1);
+            header.sections[i] = { offset, payloads[i].second };
+            offset += payloads[i].second;
+        }
+
+        // Write to a temporary file first so a crash mid-write never leaves a truncated cache behind
+        std::filesystem::path temp_path = cooked_path;
+        temp_path += ".tmp";
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open())
+            {
+                std::cerr << "Failed to write cooked mesh file " << temp_path << std::endl;
+                return false;
+            }
+            file.write(reinterpret_cast<const char*>(&header), sizeof(MeshCacheHeader));
+            uint64_t written = sizeof(MeshCacheHeader);
+            const char padding[MESH_CACHE_SECTION_ALIGNMENT] = {};
+            for (uint32_t i = 0; i < SECTION_COUNT; i++)
+            {
+                file.write(padding, static_cast<std::streamsize>(header.sections[i].offset - written));
+                file.write(static_cast<const char*>(payloads[i].first), static_cast<std::streamsize>(payloads[i].second));
+                written = header.sections[i].offset + payloads[i].second;
+            }
+            if (!file)
+            {
+                std::cerr << "Failed to write cooked mesh file " << temp_path << std::endl;
+                return false;
+            }
+        }
+        std::filesystem::rename(temp_path, cooked_path, error);
+        if (error)
+        {
+            std::cerr << "Failed to replace cooked mesh file " << cooked_path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool cook(const std::filesystem::path& source_path, const std::filesystem::path& cooked_path, ThreadPool& thread_pool)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        std::optional<SceneData> scene = loader::load_gltf(source_path, thread_pool);
+        if (!scene)
+        {
+            return false;
+        }
+        if (!write(*scene, source_path, cooked_path))
+        {
+            return false;
+        }
+
+        std::error_code error;
+        std::println("Cooked {} -> {} ({:.2f} MB) in {:.3f} ms",
+                     source_path.string(),
+                     cooked_path.string(),
+                     std::filesystem::file_size(cooked_path, error) / (1024.0 * 1024.0),
+                     std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        return true;
+    }
+} // namespace mesh_cache
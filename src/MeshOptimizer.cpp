@@ -0,0 +1,785 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace mesh_optimizer
+{
+    void Stats::add(const Stats& other)
+    {
+        triangle_count += other.triangle_count;
+        vertex_count_before += other.vertex_count_before;
+        vertex_count_after += other.vertex_count_after;
+        cache_misses_before += other.cache_misses_before;
+        cache_misses_after += other.cache_misses_after;
+    }
+
+    float Stats::acmr_before() const
+    {
+        return triangle_count > 0 ? static_cast<float>(cache_misses_before) / triangle_count : 0.0f;
+    }
+
+    float Stats::acmr_after() const
+    {
+        return triangle_count > 0 ? static_cast<float>(cache_misses_after) / triangle_count : 0.0f;
+    }
+
+    struct VertexBytesHash
+    {
+        size_t operator()(const Vertex& vertex) const
+        {
+            // FNV-1a over the raw bytes; Vertex has no padding
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+            size_t hash = 0xcbf29ce484222325ull;
+            for (size_t i = 0; i < sizeof(Vertex); i++)
+            {
+                hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+            }
+            return hash;
+        }
+    };
+
+    struct VertexBytesEqual
+    {
+        bool operator()(const Vertex& a, const Vertex& b) const
+        {
+            return memcmp(&a, &b, sizeof(Vertex)) == 0;
+        }
+    };
+
+    static_assert(sizeof(Vertex) == 12 * sizeof(float), "VertexBytesHash relies on Vertex having no padding");
+
+    size_t deduplicate_vertices(std::span<Vertex> vertices, std::span<uint32_t> indices)
+    {
+        std::unordered_map<Vertex, uint32_t, VertexBytesHash, VertexBytesEqual> unique;
+        unique.reserve(vertices.size());
+        std::vector<uint32_t> remap(vertices.size());
+        uint32_t unique_count = 0;
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            auto [it, inserted] = unique.try_emplace(vertices[v], unique_count);
+            if (inserted)
+            {
+                vertices[unique_count++] = vertices[v];
+            }
+            remap[v] = it->second;
+        }
+        for (uint32_t& index : indices)
+        {
+            index = remap[index];
+        }
+        return unique_count;
+    }
+
+    void optimize_vertex_cache(std::span<uint32_t> indices, size_t vertex_count, std::vector<uint32_t>* hard_boundaries)
+    {
+        const size_t triangle_count = indices.size() / 3;
+        if (triangle_count == 0)
+        {
+            return;
+        }
+
+        // Triangles around each vertex, and how many of them are still to be emitted
+        std::vector<uint32_t> live(vertex_count, 0);
+        for (uint32_t index : indices)
+        {
+            live[index]++;
+        }
+        std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+        std::inclusive_scan(live.begin(), live.end(), adjacency_offsets.begin() + 1);
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fill = adjacency_offsets;
+        for (uint32_t triangle = 0; triangle < triangle_count; triangle++)
+        {
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                adjacency[fill[indices[triangle * 3 + corner]]++] = triangle;
+            }
+        }
+
+        std::vector<uint32_t> output;
+        output.reserve(indices.size());
+        std::vector<bool> emitted(triangle_count, false);
+        std::vector<uint32_t> cache_time(vertex_count, 0);
+        std::vector<uint32_t> dead_ends;
+        std::vector<uint32_t> candidates;
+        uint32_t time = CACHE_SIZE + 1;
+        uint32_t input_cursor = 0;
+        int64_t fanning = indices[0];
+        bool cold = true;
+
+        while (fanning >= 0)
+        {
+            if (cold && hard_boundaries)
+            {
+                hard_boundaries->push_back(static_cast<uint32_t>(output.size() / 3));
+            }
+            candidates.clear();
+            for (uint32_t a = adjacency_offsets[fanning]; a < adjacency_offsets[fanning + 1]; a++)
+            {
+                const uint32_t triangle = adjacency[a];
+                if (emitted[triangle])
+                {
+                    continue;
+                }
+                emitted[triangle] = true;
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    const uint32_t vertex = indices[triangle * 3 + corner];
+                    output.push_back(vertex);
+                    dead_ends.push_back(vertex);
+                    candidates.push_back(vertex);
+                    live[vertex]--;
+                    if (time - cache_time[vertex] > CACHE_SIZE)
+                    {
+                        cache_time[vertex] = time++;
+                    }
+                }
+            }
+
+            // Next fanning vertex: the oldest candidate that will still be in the cache once its fan is emitted
+            fanning = -1;
+            int64_t best_priority = -1;
+            for (uint32_t vertex : candidates)
+            {
+                if (live[vertex] == 0)
+                {
+                    continue;
+                }
+                int64_t priority = 0;
+                if (time - cache_time[vertex] + 2 * live[vertex] <= CACHE_SIZE)
+                {
+                    priority = time - cache_time[vertex];
+                }
+                if (priority > best_priority)
+                {
+                    best_priority = priority;
+                    fanning = vertex;
+                }
+            }
+            cold = false;
+            if (fanning >= 0)
+            {
+                continue;
+            }
+
+            // Dead end: back off to a recently emitted vertex with triangles left, then to input order
+            while (!dead_ends.empty() && fanning < 0)
+            {
+                const uint32_t vertex = dead_ends.back();
+                dead_ends.pop_back();
+                if (live[vertex] > 0)
+                {
+                    fanning = vertex;
+                }
+            }
+            while (fanning < 0 && input_cursor < vertex_count)
+            {
+                if (live[input_cursor] > 0)
+                {
+                    fanning = input_cursor;
+                    cold = true;
+                }
+                input_cursor++;
+            }
+        }
+        std::copy(output.begin(), output.end(), indices.begin());
+    }
+
+    void optimize_overdraw(std::span<uint32_t> indices,
+                           std::span<const Vertex> vertices,
+                           std::span<const uint32_t> hard_boundaries)
+    {
+        const uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+        if (triangle_count == 0 || hard_boundaries.empty())
+        {
+            return;
+        }
+
+        // Soft boundaries: within each cache-cold run, end a cluster as soon as its own ACMR is within the threshold
+        // of the run's, so sorting clusters barely disturbs the cache order. Advancing the clock by a whole cache
+        // size empties the simulated cache without touching every vertex.
+        std::vector<uint32_t> cluster_starts;
+        std::vector<uint32_t> cache_time(vertices.size(), 0);
+        uint32_t time = CACHE_SIZE + 1;
+        auto transform = [&](uint32_t triangle)
+        {
+            uint32_t misses = 0;
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                const uint32_t vertex = indices[triangle * 3 + corner];
+                if (time - cache_time[vertex] > CACHE_SIZE)
+                {
+                    cache_time[vertex] = time++;
+                    misses++;
+                }
+            }
+            return misses;
+        };
+        for (size_t run = 0; run < hard_boundaries.size(); run++)
+        {
+            const uint32_t run_begin = hard_boundaries[run];
+            const uint32_t run_end = run + 1 < hard_boundaries.size() ? hard_boundaries[run + 1] : triangle_count;
+            if (run_begin == run_end)
+            {
+                continue;
+            }
+
+            time += CACHE_SIZE + 1;
+            uint32_t run_misses = 0;
+            for (uint32_t triangle = run_begin; triangle < run_end; triangle++)
+            {
+                run_misses += transform(triangle);
+            }
+            const float run_acmr = static_cast<float>(run_misses) / (run_end - run_begin);
+
+            time += CACHE_SIZE + 1;
+            uint32_t cluster_begin = run_begin;
+            uint32_t cluster_misses = 0;
+            cluster_starts.push_back(run_begin);
+            for (uint32_t triangle = run_begin; triangle < run_end; triangle++)
+            {
+                cluster_misses += transform(triangle);
+                const uint32_t cluster_triangles = triangle + 1 - cluster_begin;
+                if (triangle + 1 < run_end &&
+                    static_cast<float>(cluster_misses) / cluster_triangles <= run_acmr * OVERDRAW_THRESHOLD)
+                {
+                    cluster_begin = triangle + 1;
+                    cluster_misses = 0;
+                    cluster_starts.push_back(cluster_begin);
+                    time += CACHE_SIZE + 1;
+                }
+            }
+        }
+
+        auto triangle_position = [&](uint32_t triangle, uint32_t corner)
+        { return vertices[indices[triangle * 3 + corner]].position; };
+
+        glm::vec3 mesh_centroid(0.0f);
+        float mesh_area = 0.0f;
+        for (uint32_t triangle = 0; triangle < triangle_count; triangle++)
+        {
+            const glm::vec3 p0 = triangle_position(triangle, 0);
+            const glm::vec3 p1 = triangle_position(triangle, 1);
+            const glm::vec3 p2 = triangle_position(triangle, 2);
+            const float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+            mesh_centroid += (p0 + p1 + p2) * (area / 3.0f);
+            mesh_area += area;
+        }
+        mesh_centroid /= std::max(mesh_area, std::numeric_limits<float>::min());
+
+        // How far a cluster faces away from the mesh center; outward-facing clusters are drawn first
+        struct Cluster
+        {
+            uint32_t begin;
+            uint32_t end;
+            float sort_key;
+        };
+        std::vector<Cluster> clusters(cluster_starts.size());
+        for (size_t c = 0; c < cluster_starts.size(); c++)
+        {
+            Cluster& cluster = clusters[c];
+            cluster.begin = cluster_starts[c];
+            cluster.end = c + 1 < cluster_starts.size() ? cluster_starts[c + 1] : triangle_count;
+            glm::vec3 centroid(0.0f);
+            glm::vec3 normal(0.0f);
+            float area_sum = 0.0f;
+            for (uint32_t triangle = cluster.begin; triangle < cluster.end; triangle++)
+            {
+                const glm::vec3 p0 = triangle_position(triangle, 0);
+                const glm::vec3 p1 = triangle_position(triangle, 1);
+                const glm::vec3 p2 = triangle_position(triangle, 2);
+                const glm::vec3 area_normal = glm::cross(p1 - p0, p2 - p0);
+                const float area = glm::length(area_normal);
+                centroid += (p0 + p1 + p2) * (area / 3.0f);
+                normal += area_normal;
+                area_sum += area;
+            }
+            centroid /= std::max(area_sum, std::numeric_limits<float>::min());
+            const float normal_length = glm::length(normal);
+            cluster.sort_key = normal_length > 0.0f ? glm::dot(centroid - mesh_centroid, normal / normal_length) : 0.0f;
+        }
+        std::stable_sort(clusters.begin(),
+                         clusters.end(),
+                         [](const Cluster& a, const Cluster& b) { return a.sort_key > b.sort_key; });
+
+        std::vector<uint32_t> sorted;
+        sorted.reserve(indices.size());
+        for (const Cluster& cluster : clusters)
+        {
+            sorted.insert(sorted.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+        }
+        std::copy(sorted.begin(), sorted.end(), indices.begin());
+    }
+
+    size_t optimize_vertex_fetch(std::span<Vertex> vertices, std::span<uint32_t> indices)
+    {
+        constexpr uint32_t UNUSED = UINT32_MAX;
+        std::vector<uint32_t> remap(vertices.size(), UNUSED);
+        std::vector<Vertex> reordered;
+        reordered.reserve(vertices.size());
+        for (uint32_t& index : indices)
+        {
+            if (remap[index] == UNUSED)
+            {
+                remap[index] = static_cast<uint32_t>(reordered.size());
+                reordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        std::copy(reordered.begin(), reordered.end(), vertices.begin());
+        return reordered.size();
+    }
+
+    size_t simulate_cache_misses(std::span<const uint32_t> indices, size_t vertex_count)
+    {
+        // A vertex is a hit when fewer than CACHE_SIZE misses happened since it was last loaded
+        std::vector<uint32_t> cache_time(vertex_count, 0);
+        uint32_t time = CACHE_SIZE + 1;
+        size_t misses = 0;
+        for (uint32_t index : indices)
+        {
+            if (time - cache_time[index] > CACHE_SIZE)
+            {
+                cache_time[index] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+    Stats optimize(std::span<Vertex> vertices, std::span<uint32_t> indices)
+    {
+        Stats stats = {};
+        stats.triangle_count = indices.size() / 3;
+        stats.vertex_count_before = vertices.size();
+        stats.cache_misses_before = simulate_cache_misses(indices, vertices.size());
+
+        size_t vertex_count = deduplicate_vertices(vertices, indices);
+        std::vector<uint32_t> hard_boundaries;
+        optimize_vertex_cache(indices, vertex_count, &hard_boundaries);
+        optimize_overdraw(indices, vertices.first(vertex_count), hard_boundaries);
+        vertex_count = optimize_vertex_fetch(vertices.first(vertex_count), indices);
+
+        stats.vertex_count_after = vertex_count;
+        stats.cache_misses_after = simulate_cache_misses(indices, vertex_count);
+        return stats;
+    }
+
+    // Sum of squared distances to a set of planes, each weighted by the area of the triangle it came from
+    struct Quadric
+    {
+        double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+        double b2 = 0.0, bc = 0.0, bd = 0.0;
+        double c2 = 0.0, cd = 0.0;
+        double d2 = 0.0;
+        double weight = 0.0;
+
+        void add_plane(const glm::dvec3& n, double d, double area)
+        {
+            a2 += area * n.x * n.x;
+            ab += area * n.x * n.y;
+            ac += area * n.x * n.z;
+            ad += area * n.x * d;
+            b2 += area * n.y * n.y;
+            bc += area * n.y * n.z;
+            bd += area * n.y * d;
+            c2 += area * n.z * n.z;
+            cd += area * n.z * d;
+            d2 += area * d * d;
+            weight += area;
+        }
+
+        void add(const Quadric& other)
+        {
+            a2 += other.a2;
+            ab += other.ab;
+            ac += other.ac;
+            ad += other.ad;
+            b2 += other.b2;
+            bc += other.bc;
+            bd += other.bd;
+            c2 += other.c2;
+            cd += other.cd;
+            d2 += other.d2;
+            weight += other.weight;
+        }
+
+        // Area-weighted mean squared distance from `p` to the planes
+        double error(const glm::dvec3& p) const
+        {
+            const double sum = a2 * p.x * p.x + b2 * p.y * p.y + c2 * p.z * p.z +
+                               2.0 * (ab * p.x * p.y + ac * p.x * p.z + bc * p.y * p.z) +
+                               2.0 * (ad * p.x + bd * p.y + cd * p.z) + d2;
+            return weight > 0.0 ? std::max(sum, 0.0) / weight : 0.0;
+        }
+    };
+
+    struct PositionBytesHash
+    {
+        size_t operator()(const glm::vec3& position) const
+        {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&position);
+            size_t hash = 0xcbf29ce484222325ull;
+            for (size_t i = 0; i < sizeof(glm::vec3); i++)
+            {
+                hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+            }
+            return hash;
+        }
+    };
+
+    struct PositionBytesEqual
+    {
+        bool operator()(const glm::vec3& a, const glm::vec3& b) const
+        {
+            return memcmp(&a, &b, sizeof(glm::vec3)) == 0;
+        }
+    };
+
+    // Vertices that must stay where they are: anything on an open border, and anything whose position is shared by
+    // another vertex, because those differ in normal or uv and folding one of them would tear the seam open
+    static std::vector<bool> find_locked_vertices(std::span<const uint32_t> indices, std::span<const Vertex> vertices)
+    {
+        std::unordered_map<glm::vec3, uint32_t, PositionBytesHash, PositionBytesEqual> positions;
+        positions.reserve(vertices.size());
+        std::vector<uint32_t> position_ids(vertices.size());
+        std::vector<uint32_t> position_uses;
+        std::vector<bool> referenced(vertices.size(), false);
+        for (uint32_t index : indices)
+        {
+            referenced[index] = true;
+        }
+        for (uint32_t v = 0; v < vertices.size(); v++)
+        {
+            auto [it, inserted] = positions.try_emplace(vertices[v].position, static_cast<uint32_t>(positions.size()));
+            position_ids[v] = it->second;
+            if (inserted)
+            {
+                position_uses.push_back(0);
+            }
+            position_uses[it->second] += referenced[v] ? 1 : 0;
+        }
+
+        std::vector<bool> locked_positions(position_uses.size(), false);
+        for (size_t p = 0; p < position_uses.size(); p++)
+        {
+            locked_positions[p] = position_uses[p] > 1;
+        }
+
+        // An edge is on a border when no triangle walks it in the opposite direction
+        auto edge_key = [](uint32_t a, uint32_t b) { return (static_cast<uint64_t>(a) << 32) | b; };
+        std::unordered_set<uint64_t> edges;
+        edges.reserve(indices.size());
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            const size_t next = i % 3 == 2 ? i - 2 : i + 1;
+            edges.insert(edge_key(position_ids[indices[i]], position_ids[indices[next]]));
+        }
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            const size_t next = i % 3 == 2 ? i - 2 : i + 1;
+            const uint32_t a = position_ids[indices[i]];
+            const uint32_t b = position_ids[indices[next]];
+            if (!edges.contains(edge_key(b, a)))
+            {
+                locked_positions[a] = true;
+                locked_positions[b] = true;
+            }
+        }
+
+        std::vector<bool> locked(vertices.size());
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            locked[v] = locked_positions[position_ids[v]];
+        }
+        return locked;
+    }
+
+    std::vector<uint32_t> simplify(std::span<const uint32_t> indices,
+                                   std::span<const Vertex> vertices,
+                                   size_t target_index_count,
+                                   float& out_error)
+    {
+        std::vector<uint32_t> result(indices.begin(), indices.end());
+        out_error = 0.0f;
+        const size_t vertex_count = vertices.size();
+        const std::vector<bool> locked = find_locked_vertices(indices, vertices);
+
+        std::vector<Quadric> quadrics(vertex_count);
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            const glm::dvec3 p0 = vertices[result[i + 0]].position;
+            const glm::dvec3 p1 = vertices[result[i + 1]].position;
+            const glm::dvec3 p2 = vertices[result[i + 2]].position;
+            const glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+            const double length = glm::length(normal);
+            if (length == 0.0)
+            {
+                continue;
+            }
+            const glm::dvec3 n = normal / length;
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                quadrics[result[i + corner]].add_plane(n, -glm::dot(n, p0), length * 0.5);
+            }
+        }
+
+        struct Collapse
+        {
+            uint32_t from;
+            uint32_t to;
+            double cost;
+        };
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> adjacency_offsets(vertex_count + 1);
+        std::vector<uint32_t> adjacency;
+        std::vector<uint32_t> fill(vertex_count);
+        std::vector<uint32_t> remap(vertex_count);
+        std::vector<bool> touched(vertex_count);
+        double max_error = 0.0;
+
+        // Each pass collapses the cheapest edges whose neighbourhoods don't overlap, so every flip test sees the
+        // triangles as they will be after the pass
+        while (result.size() > target_index_count)
+        {
+            const uint32_t triangle_count = static_cast<uint32_t>(result.size() / 3);
+            std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+            for (uint32_t index : result)
+            {
+                adjacency_offsets[index + 1]++;
+            }
+            std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(), adjacency_offsets.begin());
+            adjacency.resize(result.size());
+            std::copy(adjacency_offsets.begin(), adjacency_offsets.end() - 1, fill.begin());
+            for (uint32_t triangle = 0; triangle < triangle_count; triangle++)
+            {
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    adjacency[fill[result[triangle * 3 + corner]]++] = triangle;
+                }
+            }
+
+            collapses.clear();
+            for (size_t i = 0; i < result.size(); i++)
+            {
+                const uint32_t a = result[i];
+                const uint32_t b = result[i % 3 == 2 ? i - 2 : i + 1];
+                // The neighbouring triangle walks the same edge as (b, a); only one of them needs to add it
+                if (a > b)
+                {
+                    continue;
+                }
+                for (auto [from, to] : { std::pair(a, b), std::pair(b, a) })
+                {
+                    if (!locked[from])
+                    {
+                        Quadric quadric = quadrics[from];
+                        quadric.add(quadrics[to]);
+                        collapses.push_back({ from, to, quadric.error(vertices[to].position) });
+                    }
+                }
+            }
+            std::sort(collapses.begin(),
+                      collapses.end(),
+                      [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+            // Folding `from` onto `to` must not turn any of the surviving triangles around `from` over
+            auto flips = [&](uint32_t from, uint32_t to)
+            {
+                for (uint32_t a = adjacency_offsets[from]; a < adjacency_offsets[from + 1]; a++)
+                {
+                    const uint32_t* triangle = &result[adjacency[a] * 3];
+                    if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                    {
+                        continue;
+                    }
+                    glm::vec3 p[3];
+                    glm::vec3 moved[3];
+                    for (uint32_t corner = 0; corner < 3; corner++)
+                    {
+                        p[corner] = vertices[triangle[corner]].position;
+                        moved[corner] = triangle[corner] == from ? vertices[to].position : p[corner];
+                    }
+                    const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                    const glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                    if (glm::dot(before, after) <= 0.0f)
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            };
+
+            std::iota(remap.begin(), remap.end(), 0u);
+            std::fill(touched.begin(), touched.end(), false);
+            const size_t triangles_to_remove = (result.size() - target_index_count + 2) / 3;
+            size_t removed = 0;
+            for (const Collapse& collapse : collapses)
+            {
+                if (removed >= triangles_to_remove)
+                {
+                    break;
+                }
+                if (touched[collapse.from] || touched[collapse.to] || flips(collapse.from, collapse.to))
+                {
+                    continue;
+                }
+                for (uint32_t a = adjacency_offsets[collapse.from]; a < adjacency_offsets[collapse.from + 1]; a++)
+                {
+                    const uint32_t* triangle = &result[adjacency[a] * 3];
+                    bool has_to = false;
+                    for (uint32_t corner = 0; corner < 3; corner++)
+                    {
+                        touched[triangle[corner]] = true;
+                        has_to |= triangle[corner] == collapse.to;
+                    }
+                    removed += has_to ? 1 : 0;
+                }
+                remap[collapse.from] = collapse.to;
+                quadrics[collapse.to].add(quadrics[collapse.from]);
+                max_error = std::max(max_error, collapse.cost);
+            }
+            if (removed == 0)
+            {
+                break;
+            }
+
+            size_t write = 0;
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                const uint32_t a = remap[result[i + 0]];
+                const uint32_t b = remap[result[i + 1]];
+                const uint32_t c = remap[result[i + 2]];
+                if (a != b && b != c && c != a)
+                {
+                    result[write++] = a;
+                    result[write++] = b;
+                    result[write++] = c;
+                }
+            }
+            result.resize(write);
+        }
+        out_error = static_cast<float>(std::sqrt(max_error));
+        return result;
+    }
+
+    // Bounding sphere and normal cone of one meshlet
+    static GPUMeshlet compute_meshlet_bounds(std::span<const uint32_t> indices,
+                                             std::span<const Vertex> vertices,
+                                             std::span<const uint32_t> meshlet_vertices)
+    {
+        glm::vec3 bounds_min(std::numeric_limits<float>::max());
+        glm::vec3 bounds_max(std::numeric_limits<float>::lowest());
+        for (uint32_t vertex : meshlet_vertices)
+        {
+            bounds_min = glm::min(bounds_min, vertices[vertex].position);
+            bounds_max = glm::max(bounds_max, vertices[vertex].position);
+        }
+        const glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+        float radius = 0.0f;
+        for (uint32_t vertex : meshlet_vertices)
+        {
+            radius = std::max(radius, glm::length(vertices[vertex].position - center));
+        }
+
+        std::vector<glm::vec3> normals;
+        normals.reserve(indices.size() / 3);
+        glm::vec3 axis(0.0f);
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            const glm::vec3 p0 = vertices[indices[i + 0]].position;
+            const glm::vec3 p1 = vertices[indices[i + 1]].position;
+            const glm::vec3 p2 = vertices[indices[i + 2]].position;
+            const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            const float length = glm::length(normal);
+            if (length > 0.0f)
+            {
+                normals.push_back(normal / length);
+                axis += normals.back();
+            }
+        }
+
+        // The cone holds every normal within acos(min_dot) of the axis. Past ~84 degrees it would never cull.
+        float cutoff = 1.0f;
+        const float axis_length = glm::length(axis);
+        if (axis_length > 0.0f)
+        {
+            axis /= axis_length;
+            float min_dot = 1.0f;
+            for (const glm::vec3& normal : normals)
+            {
+                min_dot = std::min(min_dot, glm::dot(axis, normal));
+            }
+            if (min_dot > 0.1f)
+            {
+                cutoff = std::sqrt(1.0f - min_dot * min_dot);
+            }
+        }
+
+        GPUMeshlet meshlet = {};
+        meshlet.bounds_sphere = glm::vec4(center, radius);
+        meshlet.cone = glm::vec4(axis, cutoff);
+        return meshlet;
+    }
+
+    void build_meshlets(std::span<const uint32_t> indices,
+                        std::span<const Vertex> vertices,
+                        std::vector<GPUMeshlet>& meshlets)
+    {
+        // `vertex_meshlet[v]` is the last meshlet that used v, so membership tests need no clearing
+        constexpr uint32_t NONE = UINT32_MAX;
+        std::vector<uint32_t> vertex_meshlet(vertices.size(), NONE);
+        std::vector<uint32_t> meshlet_vertices;
+        meshlet_vertices.reserve(MESHLET_MAX_VERTICES);
+        uint32_t meshlet_id = 0;
+        size_t first_index = 0;
+
+        auto finish_meshlet = [&](size_t end_index)
+        {
+            if (end_index == first_index)
+            {
+                return;
+            }
+            GPUMeshlet meshlet = compute_meshlet_bounds(
+                indices.subspan(first_index, end_index - first_index), vertices, meshlet_vertices);
+            meshlet.first_index = static_cast<uint32_t>(first_index);
+            meshlet.triangle_count = static_cast<uint32_t>((end_index - first_index) / 3);
+            meshlets.push_back(meshlet);
+            meshlet_vertices.clear();
+            first_index = end_index;
+            meshlet_id++;
+        };
+
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            uint32_t new_vertices = 0;
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                new_vertices += vertex_meshlet[indices[i + corner]] != meshlet_id ? 1 : 0;
+            }
+            // A repeated corner is counted twice above, which only ever splits a little early
+            if (meshlet_vertices.size() + new_vertices > MESHLET_MAX_VERTICES ||
+                (i - first_index) / 3 == MESHLET_MAX_TRIANGLES)
+            {
+                finish_meshlet(i);
+            }
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                const uint32_t vertex = indices[i + corner];
+                if (vertex_meshlet[vertex] != meshlet_id)
+                {
+                    vertex_meshlet[vertex] = meshlet_id;
+                    meshlet_vertices.push_back(vertex);
+                }
+            }
+        }
+        finish_meshlet(indices.size() / 3 * 3);
+    }
+} // namespace mesh_optimizer
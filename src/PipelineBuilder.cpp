@@ -25,7 +25,7 @@ void PipelineBuilder::clear()
     shader_stages.clear();
 }
 
-VkPipeline PipelineBuilder::build_pipeline(VkDevice device)
+VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkPipelineCache pipeline_cache)
 {
     VkPipelineViewportStateCreateInfo viewport_state = {};
     viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
@@ -65,7 +65,7 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device)
     pipeline_info.pDynamicState = &dynamic_info;
 
     VkPipeline new_pipeline;
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &new_pipeline) != VK_SUCCESS)
+    if (vkCreateGraphicsPipelines(device, pipeline_cache, 1, &pipeline_info, nullptr, &new_pipeline) != VK_SUCCESS)
     {
         std::cerr << "Failed to create graphics pipeline" << std::endl;
         return VK_NULL_HANDLE;
@@ -0,0 +1,179 @@
+#include "PipelineCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <print>
+#include <vector>
+
+static constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x43504B42; // "BKPC"
+static constexpr uint32_t PIPELINE_CACHE_HEADER_VERSION = 1;
+
+static uint64_t hash_bytes(const uint8_t* data, size_t size)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+void PipelineCache::init(VkDevice device, VkPhysicalDevice physical_device, const char* file_path)
+{
+    m_device = device;
+    m_file_path = file_path;
+    vkGetPhysicalDeviceProperties(physical_device, &m_properties);
+
+    std::vector<uint8_t> initial_data;
+    std::ifstream file(m_file_path, std::ios::binary | std::ios::ate);
+    if (file.is_open())
+    {
+        const size_t file_size = file.tellg();
+        file.seekg(0);
+
+        FileHeader header = {};
+        const FileHeader expected = make_header();
+        if (file_size >= sizeof(FileHeader) && file.read(reinterpret_cast<char*>(&header), sizeof(FileHeader)))
+        {
+            const bool same_device = header.magic == expected.magic &&
+                                     header.header_version == expected.header_version &&
+                                     header.vendor_id == expected.vendor_id && header.device_id == expected.device_id &&
+                                     header.driver_version == expected.driver_version &&
+                                     memcmp(header.pipeline_cache_uuid, expected.pipeline_cache_uuid, VK_UUID_SIZE) == 0;
+            if (same_device && header.data_size == file_size - sizeof(FileHeader))
+            {
+                initial_data.resize(header.data_size);
+                file.read(reinterpret_cast<char*>(initial_data.data()), header.data_size);
+                if (!file || hash_bytes(initial_data.data(), initial_data.size()) != header.data_hash)
+                {
+                    std::cerr << "Pipeline cache " << m_file_path << " is corrupt, starting cold" << std::endl;
+                    initial_data.clear();
+                }
+                else
+                {
+                    m_cold_build_ms = header.cold_build_ms;
+                }
+            }
+            else
+            {
+                std::println("Pipeline cache {} was written by a different device or driver, starting cold", m_file_path);
+            }
+        }
+    }
+
+    VkPipelineCacheCreateInfo cache_info = {};
+    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cache_info.pNext = nullptr;
+    cache_info.initialDataSize = initial_data.size();
+    cache_info.pInitialData = initial_data.empty() ? nullptr : initial_data.data();
+    if (vkCreatePipelineCache(m_device, &cache_info, nullptr, &m_cache) != VK_SUCCESS)
+    {
+        // The driver rejected the blob, retry empty rather than running without a cache
+        cache_info.initialDataSize = 0;
+        cache_info.pInitialData = nullptr;
+        initial_data.clear();
+        if (vkCreatePipelineCache(m_device, &cache_info, nullptr, &m_cache) != VK_SUCCESS)
+        {
+            std::cerr << "Failed to create pipeline cache" << std::endl;
+            m_cache = VK_NULL_HANDLE;
+        }
+    }
+
+    m_warm = !initial_data.empty();
+    m_loaded_bytes = initial_data.size();
+}
+
+void PipelineCache::save()
+{
+    if (m_cache == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    size_t data_size = 0;
+    if (vkGetPipelineCacheData(m_device, m_cache, &data_size, nullptr) != VK_SUCCESS || data_size == 0)
+    {
+        return;
+    }
+    std::vector<uint8_t> data(data_size);
+    if (vkGetPipelineCacheData(m_device, m_cache, &data_size, data.data()) != VK_SUCCESS)
+    {
+        return;
+    }
+    data.resize(data_size);
+
+    FileHeader header = make_header();
+    header.data_size = data.size();
+    header.data_hash = hash_bytes(data.data(), data.size());
+    {
+        std::lock_guard lock(m_stats_mutex);
+        header.cold_build_ms = m_warm ? m_cold_build_ms : m_build_ms;
+    }
+
+    // Write to a temporary file first so a crash mid-write never leaves a truncated cache behind
+    const std::string temp_path = m_file_path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            std::cerr << "Failed to write pipeline cache " << temp_path << std::endl;
+            return;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+    std::remove(m_file_path.c_str());
+    if (std::rename(temp_path.c_str(), m_file_path.c_str()) != 0)
+    {
+        std::cerr << "Failed to replace pipeline cache " << m_file_path << std::endl;
+    }
+}
+
+void PipelineCache::destroy()
+{
+    vkDestroyPipelineCache(m_device, m_cache, nullptr);
+    m_cache = VK_NULL_HANDLE;
+}
+
+void PipelineCache::record_pipeline_build(const char* name, double milliseconds)
+{
+    std::lock_guard lock(m_stats_mutex);
+    m_build_ms += milliseconds;
+    m_build_count++;
+    std::println("Pipeline '{}' built in {:.3f} ms", name, milliseconds);
+}
+
+void PipelineCache::print_stats() const
+{
+    std::lock_guard lock(m_stats_mutex);
+    if (m_warm)
+    {
+        std::println("Pipeline cache: warm ({} bytes), {} pipelines built in {:.3f} ms, cold start took {:.3f} ms "
+                     "(saved {:.3f} ms)",
+                     m_loaded_bytes,
+                     m_build_count,
+                     m_build_ms,
+                     m_cold_build_ms,
+                     m_cold_build_ms - m_build_ms);
+    }
+    else
+    {
+        std::println("Pipeline cache: cold, {} pipelines built in {:.3f} ms", m_build_count, m_build_ms);
+    }
+}
+
+PipelineCache::FileHeader PipelineCache::make_header() const
+{
+    FileHeader header = {};
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.header_version = PIPELINE_CACHE_HEADER_VERSION;
+    header.vendor_id = m_properties.vendorID;
+    header.device_id = m_properties.deviceID;
+    header.driver_version = m_properties.driverVersion;
+    memcpy(header.pipeline_cache_uuid, m_properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
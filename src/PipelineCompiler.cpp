@@ -0,0 +1,73 @@
+#include "PipelineCompiler.h"
+
+#include <print>
+
+bool PipelineJob::is_ready() const
+{
+    return m_future.valid() && m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+VkPipeline PipelineJob::try_get() const
+{
+    return is_ready() ? m_future.get() : VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineJob::get() const
+{
+    return m_future.valid() ? m_future.get() : VK_NULL_HANDLE;
+}
+
+void PipelineCompiler::init(PipelineCache* pipeline_cache, ThreadPool* thread_pool)
+{
+    m_pipeline_cache = pipeline_cache;
+    m_thread_pool = thread_pool;
+}
+
+PipelineJob PipelineCompiler::enqueue(std::string name, BuildFunction&& build)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_outstanding == 0)
+        {
+            m_batch_start = std::chrono::steady_clock::now();
+            m_batch_count = 0;
+        }
+        m_outstanding++;
+        m_batch_count++;
+    }
+
+    PipelineJob job;
+    job.m_future = m_thread_pool
+                       ->submit(
+                           [this, name = std::move(name), build = std::move(build)]()
+                           {
+                               const auto build_start = std::chrono::steady_clock::now();
+                               VkPipeline pipeline = build(m_pipeline_cache->get());
+                               const auto build_end = std::chrono::steady_clock::now();
+                               m_pipeline_cache->record_pipeline_build(
+                                   name.c_str(),
+                                   std::chrono::duration<double, std::milli>(build_end - build_start).count());
+
+                               std::lock_guard lock(m_mutex);
+                               if (--m_outstanding == 0)
+                               {
+                                   // Wall time against the serial sum shows how well compilation scales with cores
+                                   std::println(
+                                       "{} pipelines compiled on {} threads in {:.3f} ms wall time",
+                                       m_batch_count,
+                                       m_thread_pool->get_thread_count(),
+                                       std::chrono::duration<double, std::milli>(build_end - m_batch_start).count());
+                                   m_pipeline_cache->print_stats();
+                                   m_idle_condition.notify_all();
+                               }
+                               return pipeline;
+                           })
+                       .share();
+    return job;
+}
+
+void PipelineCompiler::wait_idle()
+{
+    std::unique_lock lock(m_mutex);
+    m_idle_condition.wait(lock, [this]() { return m_outstanding == 0; });
+}
@@ -0,0 +1,356 @@
+#include "RenderGraph.h"
+#include "GpuProfiler.h"
+#include "Initializers.h"
+
+#include <cassert>
+
+// Access bits that make memory available to later accesses; everything else only needs visibility
+static constexpr VkAccessFlags2 WRITE_ACCESS_MASK =
+    VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT |
+    VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(RGHandle resource,
+                                                         VkPipelineStageFlags2 stage,
+                                                         VkAccessFlags2 access,
+                                                         VkImageLayout layout)
+{
+    m_graph.add_access(m_pass_index, { resource, stage, access, layout, false, false });
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(RGHandle resource,
+                                                          VkPipelineStageFlags2 stage,
+                                                          VkAccessFlags2 access,
+                                                          VkImageLayout layout,
+                                                          bool discard)
+{
+    m_graph.add_access(m_pass_index, { resource, stage, access, layout, true, discard });
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::side_effect()
+{
+    m_graph.m_passes[m_pass_index].side_effect = true;
+    return *this;
+}
+
+RGHandle RenderGraph::add_resource(const Resource& resource)
+{
+    for (RGHandle handle = 0; handle < m_resources.size(); handle++)
+    {
+        if (m_resources[handle].key == resource.key)
+        {
+            return handle;
+        }
+    }
+    m_resources.push_back(resource);
+    return static_cast<RGHandle>(m_resources.size() - 1);
+}
+
+RGHandle RenderGraph::import_image(VkImage image, VkImageAspectFlags aspect)
+{
+    Resource resource = {};
+    resource.key = (uint64_t)image;
+    resource.image = image;
+    resource.aspect = aspect;
+    return add_resource(resource);
+}
+
+RGHandle RenderGraph::import_buffer(VkBuffer buffer)
+{
+    Resource resource = {};
+    resource.key = (uint64_t)buffer;
+    resource.buffer = buffer;
+    return add_resource(resource);
+}
+
+void RenderGraph::set_initial_state(RGHandle image, VkPipelineStageFlags2 stage, VkImageLayout layout)
+{
+    ResourceState& state = m_states[m_resources[image].key];
+    state = {};
+    state.layout = layout;
+    state.write_stage = stage;
+}
+
+void RenderGraph::set_final_layout(RGHandle image, VkImageLayout layout)
+{
+    m_resources[image].final_layout = layout;
+    m_resources[image].output = true;
+}
+
+void RenderGraph::mark_output(RGHandle resource)
+{
+    m_resources[resource].output = true;
+}
+
+void RenderGraph::alias(RGHandle a, RGHandle b)
+{
+    m_resources[a].aliases.push_back(b);
+    m_resources[b].aliases.push_back(a);
+}
+
+RenderGraph::PassBuilder RenderGraph::add_pass(const char* name, ExecuteFunction&& execute)
+{
+    Pass pass = {};
+    pass.name = name;
+    pass.execute = std::move(execute);
+    m_passes.push_back(std::move(pass));
+    return PassBuilder(*this, static_cast<uint32_t>(m_passes.size() - 1));
+}
+
+void RenderGraph::add_access(uint32_t pass_index, const Access& access)
+{
+    // Several uses of one resource in a pass (e.g. indirect arguments and a vertex-stage storage read) become one
+    // access, so the pass boundary gets a single barrier for it
+    for (Access& existing : m_passes[pass_index].accesses)
+    {
+        if (existing.resource == access.resource)
+        {
+            assert(existing.layout == access.layout && "A pass can only use an image in one layout");
+            existing.stage |= access.stage;
+            existing.access |= access.access;
+            // Any read or partial write keeps the previous contents alive
+            existing.discard = existing.discard && access.discard;
+            existing.write |= access.write;
+            return;
+        }
+    }
+    m_passes[pass_index].accesses.push_back(access);
+}
+
+std::vector<bool> RenderGraph::cull_passes() const
+{
+    // Walk backwards from the outputs. A pass survives if it has a side effect or writes something a surviving
+    // later pass (or the outside world) still needs; a discarding write ends the need for everything before it.
+    std::vector<bool> needed_resources(m_resources.size());
+    for (size_t i = 0; i < m_resources.size(); i++)
+    {
+        needed_resources[i] = m_resources[i].output;
+    }
+
+    std::vector<bool> keep(m_passes.size(), false);
+    for (size_t pass_index = m_passes.size(); pass_index-- > 0;)
+    {
+        const Pass& pass = m_passes[pass_index];
+        bool needed = pass.side_effect;
+        for (const Access& access : pass.accesses)
+        {
+            needed |= access.write && needed_resources[access.resource];
+        }
+        if (!needed)
+        {
+            continue;
+        }
+        keep[pass_index] = true;
+        for (const Access& access : pass.accesses)
+        {
+            needed_resources[access.resource] = !(access.write && access.discard);
+        }
+    }
+    return keep;
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd, GpuProfiler* profiler)
+{
+    const std::vector<bool> keep = cull_passes();
+
+    std::vector<VkImageMemoryBarrier2> image_barriers;
+    std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+    auto add_barrier = [&](const Resource& resource,
+                           const ResourceState& state,
+                           VkPipelineStageFlags2 dst_stage,
+                           VkAccessFlags2 dst_access,
+                           VkImageLayout old_layout,
+                           VkImageLayout new_layout)
+    {
+        const VkPipelineStageFlags2 src_stage = state.write_stage | state.read_stages;
+        if (resource.image != VK_NULL_HANDLE)
+        {
+            VkImageMemoryBarrier2 barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+            barrier.pNext = nullptr;
+            barrier.srcStageMask = src_stage;
+            barrier.srcAccessMask = state.write_access;
+            barrier.dstStageMask = dst_stage;
+            barrier.dstAccessMask = dst_access;
+            barrier.oldLayout = old_layout;
+            barrier.newLayout = new_layout;
+            barrier.subresourceRange = init::image_subresource_range(resource.aspect);
+            barrier.image = resource.image;
+            image_barriers.push_back(barrier);
+        }
+        else
+        {
+            VkBufferMemoryBarrier2 barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+            barrier.pNext = nullptr;
+            barrier.srcStageMask = src_stage;
+            barrier.srcAccessMask = state.write_access;
+            barrier.dstStageMask = dst_stage;
+            barrier.dstAccessMask = dst_access;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = resource.buffer;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            buffer_barriers.push_back(barrier);
+        }
+    };
+
+    auto flush_barriers = [&]()
+    {
+        if (image_barriers.empty() && buffer_barriers.empty())
+        {
+            return;
+        }
+        VkDependencyInfo dependency_info = {};
+        dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency_info.pNext = nullptr;
+        dependency_info.imageMemoryBarrierCount = static_cast<uint32_t>(image_barriers.size());
+        dependency_info.pImageMemoryBarriers = image_barriers.data();
+        dependency_info.bufferMemoryBarrierCount = static_cast<uint32_t>(buffer_barriers.size());
+        dependency_info.pBufferMemoryBarriers = buffer_barriers.data();
+        vkCmdPipelineBarrier2(cmd, &dependency_info);
+        m_last_barrier_count++;
+        image_barriers.clear();
+        buffer_barriers.clear();
+    };
+
+    std::vector<bool> touched(m_resources.size(), false);
+    auto use = [&](const Access& access)
+    {
+        const Resource& resource = m_resources[access.resource];
+        ResourceState& state = m_states[resource.key];
+        const bool is_image = resource.image != VK_NULL_HANDLE;
+
+        // The first use of an aliased image finds whatever its aliases left in the shared memory
+        ResourceState wait_state = state;
+        bool discard = access.discard;
+        if (!touched[access.resource] && !resource.aliases.empty())
+        {
+            for (const RGHandle alias : resource.aliases)
+            {
+                const ResourceState& alias_state = m_states[m_resources[alias].key];
+                wait_state.write_stage |= alias_state.write_stage | alias_state.read_stages;
+                wait_state.write_access |= alias_state.write_access;
+            }
+            discard = true;
+        }
+        touched[access.resource] = true;
+
+        const VkImageLayout old_layout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+        const bool layout_change = is_image && old_layout != access.layout;
+
+        if (access.write || layout_change)
+        {
+            // Writes and layout transitions wait for the last write and every read since
+            if (wait_state.write_stage != VK_PIPELINE_STAGE_2_NONE ||
+                wait_state.read_stages != VK_PIPELINE_STAGE_2_NONE || layout_change)
+            {
+                add_barrier(resource, wait_state, access.stage, access.access, old_layout, access.layout);
+            }
+            // A transition behaves like a write at the destination stage for anyone that comes later
+            state.layout = access.layout;
+            state.write_stage = access.stage;
+            state.write_access = access.write ? (access.access & WRITE_ACCESS_MASK) : VK_ACCESS_2_NONE;
+            state.read_stages = access.write ? VK_PIPELINE_STAGE_2_NONE : access.stage;
+            state.visible_stages = access.stage;
+            state.visible_access = access.access;
+            return;
+        }
+
+        // Reads only wait for the last write, and only once per stage and access
+        const bool covered =
+            (access.stage & ~state.visible_stages) == 0 && (access.access & ~state.visible_access) == 0;
+        if (state.write_stage != VK_PIPELINE_STAGE_2_NONE && !covered)
+        {
+            ResourceState write_state = state;
+            write_state.read_stages = VK_PIPELINE_STAGE_2_NONE;
+            add_barrier(resource, write_state, access.stage, access.access, state.layout, state.layout);
+            state.visible_stages |= access.stage;
+            state.visible_access |= access.access;
+        }
+        state.read_stages |= access.stage;
+    };
+
+    m_last_pass_count = static_cast<uint32_t>(m_passes.size());
+    m_last_culled_pass_count = 0;
+    m_last_barrier_count = 0;
+    m_lifetimes.clear();
+    uint32_t recorded_pass = 0;
+    for (size_t pass_index = 0; pass_index < m_passes.size(); pass_index++)
+    {
+        Pass& pass = m_passes[pass_index];
+        if (!keep[pass_index])
+        {
+            m_last_culled_pass_count++;
+            continue;
+        }
+        for (const Access& access : pass.accesses)
+        {
+            use(access);
+            const Resource& resource = m_resources[access.resource];
+            if (resource.image != VK_NULL_HANDLE)
+            {
+                Lifetime& lifetime = m_lifetimes.try_emplace(resource.key, Lifetime{ recorded_pass, 0 }).first->second;
+                lifetime.last_pass = recorded_pass;
+            }
+        }
+        recorded_pass++;
+        flush_barriers();
+
+        if (profiler != nullptr)
+        {
+            GpuProfileScope scope(*profiler, cmd, pass.name);
+            pass.execute(cmd);
+        }
+        else
+        {
+            pass.execute(cmd);
+        }
+    }
+
+    // Hand images over in the layout the outside world expects, e.g. PRESENT_SRC for the swapchain
+    for (RGHandle handle = 0; handle < m_resources.size(); handle++)
+    {
+        const Resource& resource = m_resources[handle];
+        if (resource.final_layout != VK_IMAGE_LAYOUT_UNDEFINED)
+        {
+            use({ handle,
+                  VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                  VK_ACCESS_2_NONE,
+                  resource.final_layout,
+                  false,
+                  false });
+        }
+    }
+    flush_barriers();
+
+    m_passes.clear();
+    m_resources.clear();
+}
+
+void RenderGraph::forget_all()
+{
+    m_states.clear();
+    m_lifetimes.clear();
+}
+
+void RenderGraph::forget(VkImage image)
+{
+    m_states.erase((uint64_t)image);
+    m_lifetimes.erase((uint64_t)image);
+}
+
+bool RenderGraph::get_lifetime(VkImage image, uint32_t& first_pass, uint32_t& last_pass) const
+{
+    const auto lifetime = m_lifetimes.find((uint64_t)image);
+    if (lifetime == m_lifetimes.end())
+    {
+        return false;
+    }
+    first_pass = lifetime->second.first_pass;
+    last_pass = lifetime->second.last_pass;
+    return true;
+}
@@ -8,9 +8,14 @@
 #include <iostream>
 #include <print>
 #include <random>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 
 #include <vulkan/vulkan_core.h>
 #include "Types.h"
+#include "VertexQuantization.h"
 #include "VkBootstrap.h"
 #include "glm/fwd.hpp"
 #include "imgui.h"
@@ -20,38 +25,80 @@
 #include "Utilities.h"
 #include <glm/gtx/transform.hpp>
 #include "PipelineBuilder.h"
+#include "MeshCache.h"
 
-void Renderer::init()
+void Renderer::init(const RendererSettings& settings)
 {
-    init_sdl();
+    const auto init_start = std::chrono::steady_clock::now();
+    m_settings = settings;
+    m_enable_gpu_culling = m_settings.enable_gpu_culling;
+    m_enable_occlusion_culling = m_settings.enable_occlusion_culling;
+    m_lod_error_pixels = m_settings.lod_error_pixels;
+    m_enable_meshlet_culling = m_settings.meshlet_culling;
+    m_enable_direct_draws = m_settings.direct_draws;
+    m_max_recording_threads = std::clamp(m_settings.recording_threads, 1u, MAX_RECORDING_THREADS);
+    m_recording_threads = m_max_recording_threads;
+    m_enable_async_compute = m_settings.enable_async_compute;
+    m_frames_in_flight = std::clamp(m_settings.frames_in_flight, 1u, MAX_FRAMES_IN_FLIGHT);
+    m_dynamic_resolution.set_target_ms(m_settings.target_frame_ms);
+    m_dynamic_resolution.set_scale_range(m_settings.min_render_scale, 1.0f);
+    m_dynamic_resolution.set_latency(m_frames_in_flight);
+    if (m_settings.headless)
+    {
+        // No window, surface or swapchain. Everything renders into the draw image only.
+        m_window_extent = m_settings.headless_extent;
+        m_swapchain_data.swapchain_extent_2D = m_window_extent;
+    }
+    else
+    {
+        init_sdl();
+    }
     create_instance();
-    create_surface();
+    if (!m_settings.headless)
+    {
+        create_surface();
+    }
     pick_physical_device();
     create_device();
-    create_swapchain();
+    init_thread_pool();
+    init_pipeline_cache();
+    if (!m_settings.headless)
+    {
+        create_swapchain();
+    }
     init_vma();
+    init_staging_ring();
+    init_uploader();
     init_descriptors();
-    create_draw_image();
-    create_depth_image();
+    init_render_targets();
     create_command_buffers();
     init_sync_structures();
+    init_gpu_profiler();
     init_triangle_pipeline();
     init_compute_pipeline();
-    init_imgui();
+    init_depth_pyramid();
+    init_cull_pipeline();
+    if (!m_settings.headless)
+    {
+        init_imgui();
+    }
     init_default_data();
+
+    std::println("Renderer init took {:.3f} ms",
+                 std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - init_start).count());
 }
 
 void Renderer::destroy()
 {
+    m_uploader.wait_idle();
     VK_CHECK(vkDeviceWaitIdle(m_device));
-    m_swapchain_data.swapchain.destroy_image_views(m_swapchain_data.swapchain_image_views);
-    vkb::destroy_swapchain(m_swapchain_data.swapchain);
-    destroy_image(m_swapchain_data.draw_image);
-    destroy_image(m_swapchain_data.depth_image);
-    for (auto& frame : m_frame_data)
+    if (!m_settings.headless)
     {
-        frame.flush_frame_data();
+        m_swapchain_data.swapchain.destroy_image_views(m_swapchain_data.swapchain_image_views);
+        vkb::destroy_swapchain(m_swapchain_data.swapchain);
     }
+    m_transient_allocator.destroy();
+    m_timeline_deletion_queue.flush_all();
     m_deletion_queue.flush();
 }
 
@@ -60,6 +107,12 @@ void Renderer::run()
     bool done = false;
     while (!done)
     {
+        if (m_settings.low_latency)
+        {
+            // Sample input only once the previous frame is done, so the new frame never queues behind it
+            wait_for_frame(m_frame_data[(m_frame_index + m_frames_in_flight - 1) % m_frames_in_flight]);
+        }
+
         SDL_Event event;
         while (SDL_PollEvent(&event))
         {
@@ -77,6 +130,7 @@ void Renderer::run()
         }
 
         update_mouse_position();
+        m_input_sample_time = std::chrono::steady_clock::now();
 
         if (SDL_GetWindowFlags(m_window) & SDL_WINDOW_MINIMIZED)
         {
@@ -104,14 +158,251 @@ void Renderer::run()
             ImGui::InputFloat4("Color 1", (float*)&m_compute_push_constants.color1);
             ImGui::InputFloat4("Color 2", (float*)&m_compute_push_constants.color2);
             ImGui::InputFloat4("Work Group Coords", (float*)&m_compute_push_constants.cell_coords);
+            ImGui::Checkbox("Stream instance transforms", &m_stream_instance_transforms);
+            ImGui::Checkbox("GPU frustum culling", &m_enable_gpu_culling);
+            ImGui::Checkbox("Occlusion culling", &m_enable_occlusion_culling);
+            ImGui::SliderFloat("LOD error (pixels)", &m_lod_error_pixels, 0.0f, 8.0f);
+            if (m_scene.draw_list.meshlet_index_capacity > 0)
+            {
+                ImGui::Checkbox("Meshlet culling", &m_enable_meshlet_culling);
+            }
+            ImGui::Checkbox("Direct draws (CPU recorded)", &m_enable_direct_draws);
+            if (m_max_recording_threads > 1)
+            {
+                const uint32_t min_threads = 1;
+                ImGui::SliderScalar("Recording threads",
+                                    ImGuiDataType_U32,
+                                    &m_recording_threads,
+                                    &min_threads,
+                                    &m_max_recording_threads);
+            }
+            if (m_compute_queue != VK_NULL_HANDLE)
+            {
+                ImGui::Checkbox("Async compute background", &m_enable_async_compute);
+            }
+            else
+            {
+                ImGui::TextUnformatted("Async compute: no separate compute queue");
+            }
+            ImGui::Text("Background %.3f ms on %s, graphics frame %.3f ms",
+                        m_last_background_ms,
+                        use_async_compute() ? "async compute" : "graphics",
+                        m_last_gpu_frame_ms);
+            ImGui::Text("Draws: %u, drawn %u early + %u late",
+                        m_cull_stats_draw_count,
+                        m_cull_stats.early_draw_count,
+                        m_cull_stats.late_draw_count);
+            ImGui::Text("Rejected: %u frustum, %u occlusion",
+                        m_cull_stats.frustum_rejected,
+                        m_cull_stats.occlusion_rejected);
+            ImGui::Text("LOD draws: %u / %u / %u / %u, %u triangles",
+                        m_cull_stats.lod_draw_counts[0],
+                        m_cull_stats.lod_draw_counts[1],
+                        m_cull_stats.lod_draw_counts[2],
+                        m_cull_stats.lod_draw_counts[3],
+                        m_cull_stats.triangle_count);
+            if (m_cull_stats.meshlet_count > 0)
+            {
+                ImGui::Text("Meshlets: %u tested, %u frustum, %u cone, %u dropped, %.2f MB of stream",
+                            m_cull_stats.meshlet_count,
+                            m_cull_stats.meshlet_frustum_rejected,
+                            m_cull_stats.meshlet_cone_rejected,
+                            m_cull_stats.meshlet_overflow,
+                            m_cull_stats.meshlet_index_count * sizeof(uint32_t) / (1024.0 * 1024.0));
+            }
+            if (m_culled_geometry.direct)
+            {
+                ImGui::Text("Direct draws: %zu, recorded in %.3f ms on %u threads",
+                            m_culled_geometry.draw_list->draw_items.size(),
+                            m_average_recording_ms,
+                            m_recording_threads);
+            }
+            ImGui::Text("Render graph: %u passes (%u culled), %u barriers",
+                        m_render_graph.get_last_pass_count(),
+                        m_render_graph.get_last_culled_pass_count(),
+                        m_render_graph.get_last_barrier_count());
+            ImGui::Text("Render targets: %.2f MB in %u blocks, %.2f MB saved by aliasing",
+                        m_transient_allocator.get_allocated_bytes() / (1024.0 * 1024.0),
+                        m_transient_allocator.get_block_count(),
+                        (m_transient_allocator.get_requested_bytes() - m_transient_allocator.get_allocated_bytes()) /
+                            (1024.0 * 1024.0));
+            ImGui::Text("Bindless (%s): %u textures, %u samplers, %u storage images, %u buffers",
+                        m_bindless_table.uses_descriptor_buffer() ? "descriptor buffer" : "descriptor indexing",
+                        m_bindless_table.get_used_count(BindlessBinding::SampledImage),
+                        m_bindless_table.get_used_count(BindlessBinding::Sampler),
+                        m_bindless_table.get_used_count(BindlessBinding::StorageImage),
+                        m_bindless_table.get_used_count(BindlessBinding::StorageBuffer));
+            const DescriptorAllocator& frame_descriptors = get_current_frame().descriptor_allocator;
+            ImGui::Text("Frame descriptors: %u pools, %u sets last frame, %llu allocated in total",
+                        frame_descriptors.get_pool_count(),
+                        frame_descriptors.get_last_set_count(),
+                        static_cast<unsigned long long>(frame_descriptors.get_total_set_count()));
+            constexpr std::array<VkPresentModeKHR, 3> PRESENT_MODES = {
+                VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR
+            };
+            if (ImGui::BeginCombo("Present mode", string_VkPresentModeKHR(m_settings.present_mode)))
+            {
+                for (VkPresentModeKHR present_mode : PRESENT_MODES)
+                {
+                    const bool selected = present_mode == m_settings.present_mode;
+                    if (ImGui::Selectable(string_VkPresentModeKHR(present_mode), selected))
+                    {
+                        m_settings.present_mode = present_mode;
+                        m_swapchain_data.resize_requested = true;
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            ImGui::Checkbox("Low latency", &m_settings.low_latency);
+            ImGui::Text("%u frames in flight, %zu swapchain images (%s)",
+                        m_frames_in_flight,
+                        m_swapchain_data.swapchain_images.size(),
+                        string_VkPresentModeKHR(m_swapchain_data.swapchain.present_mode));
+            ImGui::Text("Input latency: %.2f ms (avg %.2f ms) to GPU completion",
+                        m_last_input_latency_ms,
+                        m_average_input_latency_ms);
+            ImGui::Checkbox("Dynamic resolution", &m_settings.dynamic_resolution);
+            if (ImGui::SliderFloat("Target GPU ms", &m_settings.target_frame_ms, 2.0f, 50.0f, "%.1f"))
+            {
+                m_dynamic_resolution.set_target_ms(m_settings.target_frame_ms);
+            }
+            ImGui::Text("Render scale %.2f: %ux%u of %ux%u",
+                        m_dynamic_resolution.get_scale(),
+                        m_swapchain_data.draw_extent_2D.width,
+                        m_swapchain_data.draw_extent_2D.height,
+                        m_swapchain_data.swapchain_extent_2D.width,
+                        m_swapchain_data.swapchain_extent_2D.height);
+            ImGui::Text("Staging ring: %.2f / %.2f MB",
+                        m_staging_ring.get_used_bytes(m_frame_index % m_frames_in_flight) / (1024.0 * 1024.0),
+                        m_staging_ring.get_partition_size() / (1024.0 * 1024.0));
         }
         ImGui::End();
 
+        m_gpu_profiler.draw_imgui_panel();
+
         ImGui::Render();
         draw_frame();
     }
 }
 
+BenchmarkResult Renderer::run_benchmark(uint32_t frame_count, uint32_t warmup_frame_count)
+{
+    using clock = std::chrono::steady_clock;
+
+    // Pipelines compile and the scene uploads in the background, and frames skip whatever isn't ready. Measured
+    // frames have to draw everything.
+    m_pipeline_compiler.wait_idle();
+    m_uploader.wait_idle();
+
+    for (uint32_t i = 0; i < warmup_frame_count; i++)
+    {
+        draw_frame();
+    }
+    VK_CHECK(vkDeviceWaitIdle(m_device));
+
+    double cpu_ms_total = 0.0;
+    double gpu_ms_total = 0.0;
+    double recording_ms_total = 0.0;
+    double cull_ms_total = 0.0;
+    double geometry_ms_total = 0.0;
+    double meshlet_cull_ms_total = 0.0;
+    uint32_t gpu_samples = 0;
+    // Pass times come from the frame collect_gpu_timings just read back. A pass that frame didn't record counts as 0.
+    const auto pass_ms = [this](const char* name)
+    {
+        double ms = 0.0;
+        return m_gpu_profiler.get_collected_ms(name, ms) ? ms : 0.0;
+    };
+    const auto add_gpu_sample = [&]()
+    {
+        gpu_ms_total += m_last_gpu_frame_ms;
+        cull_ms_total += pass_ms("Cull") + pass_ms("Cull Late");
+        geometry_ms_total += pass_ms("Geometry") + pass_ms("Geometry Late");
+        meshlet_cull_ms_total += pass_ms("Cull Meshlets") + pass_ms("Cull Meshlets Late");
+        gpu_samples++;
+    };
+
+    const auto bench_start = clock::now();
+    for (uint32_t i = 0; i < frame_count; i++)
+    {
+        const auto frame_start = clock::now();
+        draw_frame();
+        cpu_ms_total += std::chrono::duration<double, std::milli>(clock::now() - frame_start).count();
+        recording_ms_total += m_last_recording_ms;
+
+        // draw_frame reads back the timestamps of the frame that last used this slot. The first reads belong to
+        // warmup frames.
+        if (i >= m_frames_in_flight && m_gpu_frame_collected)
+        {
+            add_gpu_sample();
+        }
+    }
+    VK_CHECK(vkDeviceWaitIdle(m_device));
+    const auto bench_end = clock::now();
+
+    // Collect the frames still in flight when the loop ended
+    for (uint32_t i = 0; i < m_frames_in_flight && i < frame_count; i++)
+    {
+        collect_cull_stats((m_frame_index + i) % m_frames_in_flight);
+        if (collect_gpu_timings((m_frame_index + i) % m_frames_in_flight))
+        {
+            add_gpu_sample();
+        }
+    }
+
+    BenchmarkResult result = {};
+    result.frame_count = frame_count;
+    result.frames_in_flight = m_frames_in_flight;
+    result.total_seconds = std::chrono::duration<double>(bench_end - bench_start).count();
+    if (frame_count > 0)
+    {
+        result.frames_per_second = frame_count / result.total_seconds;
+        result.cpu_ms_per_frame = cpu_ms_total / frame_count;
+    }
+    if (gpu_samples > 0)
+    {
+        result.gpu_ms_per_frame = gpu_ms_total / gpu_samples;
+        result.cull_ms = cull_ms_total / gpu_samples;
+        result.geometry_ms = geometry_ms_total / gpu_samples;
+        result.meshlet_cull_ms = meshlet_cull_ms_total / gpu_samples;
+    }
+    result.draw_count = m_cull_stats_draw_count;
+    result.drawn_count = m_cull_stats.early_draw_count + m_cull_stats.late_draw_count;
+    result.frustum_rejected = m_cull_stats.frustum_rejected;
+    result.occlusion_rejected = m_cull_stats.occlusion_rejected;
+    result.render_target_bytes = m_transient_allocator.get_allocated_bytes();
+    result.render_target_saved_bytes =
+        m_transient_allocator.get_requested_bytes() - m_transient_allocator.get_allocated_bytes();
+    result.async_compute = use_async_compute();
+    result.background_ms = m_last_background_ms;
+    result.render_scale = m_dynamic_resolution.get_scale();
+    result.descriptor_buffer = m_bindless_table.uses_descriptor_buffer();
+    const GPUMeshBuffers& instanced_mesh = m_scene.loaded ? m_scene.buffers : m_rectangle;
+    result.instance_count = instanced_mesh.instance_count;
+    result.instance_transform_bytes = instanced_mesh.instance_count * sizeof(GPUInstanceTransform);
+    result.quantized_vertices = m_settings.quantized_vertices;
+    result.vertex_bytes = instanced_mesh.vertex_bytes;
+    result.vertex_count =
+        instanced_mesh.vertex_bytes / (m_settings.quantized_vertices ? sizeof(QuantizedVertex) : sizeof(Vertex));
+    result.index_count = instanced_mesh.index_count;
+    result.index_size = instanced_mesh.index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    result.drawn_triangle_count = m_cull_stats.triangle_count;
+    std::ranges::copy(m_cull_stats.lod_draw_counts, result.lod_draw_counts);
+    result.meshlet_culling = m_culled_geometry.meshlets;
+    result.meshlet_count = m_cull_stats.meshlet_count;
+    result.meshlet_frustum_rejected = m_cull_stats.meshlet_frustum_rejected;
+    result.meshlet_cone_rejected = m_cull_stats.meshlet_cone_rejected;
+    result.meshlet_overflow = m_cull_stats.meshlet_overflow;
+    result.direct_draws = m_culled_geometry.direct;
+    if (result.direct_draws)
+    {
+        result.direct_draw_count = static_cast<uint32_t>(m_culled_geometry.draw_list->draw_items.size());
+        result.recording_threads = m_recording_threads;
+        result.recording_ms = frame_count > 0 ? recording_ms_total / frame_count : 0.0;
+    }
+    return result;
+}
+
 void Renderer::init_imgui()
 {
     IMGUI_CHECKVERSION();
@@ -128,7 +419,7 @@ void Renderer::init_imgui()
     init_info.Device = m_device;
     init_info.QueueFamily = m_device.get_queue_index(vkb::QueueType::graphics).value();
     init_info.Queue = m_device.get_queue(vkb::QueueType::graphics).value();
-    // init_info.PipelineCache = YOUR_PIPELINE_CACHE; // optional
+    init_info.PipelineCache = m_pipeline_cache.get();
     // init_info.DescriptorPool = YOUR_DESCRIPTOR_POOL; // see below Todo: Check if the DescriptorPoolSize is correct
     init_info.DescriptorPoolSize =
         IMGUI_IMPL_VULKAN_MINIMUM_IMAGE_SAMPLER_POOL_SIZE; // (Optional) Set to create internal descriptor pool instead
@@ -250,16 +541,24 @@ void Renderer::create_instance()
     std::println("Instance API: {}", system_info.instance_api_version);
 
     uint32_t sdl_extension_count = 0;
-    const char* const* sdl_extensions = SDL_Vulkan_GetInstanceExtensions(&sdl_extension_count);
+    const char* const* sdl_extensions = nullptr;
+    if (!m_settings.headless)
+    {
+        sdl_extensions = SDL_Vulkan_GetInstanceExtensions(&sdl_extension_count);
+    }
 
     vkb::InstanceBuilder instance_builder;
-    auto instance_builder_return = instance_builder.set_app_name("Compute Shader Playground")
-                                       .set_engine_name("Compute Shader Playground")
-                                       .require_api_version(1, 4, 0)
-                                       .enable_validation_layers()
-                                       .use_default_debug_messenger()
-                                       .enable_extensions(static_cast<size_t>(sdl_extension_count), sdl_extensions)
-                                       .build();
+    instance_builder.set_app_name("Compute Shader Playground")
+        .set_engine_name("Compute Shader Playground")
+        .require_api_version(1, 4, 0)
+        .set_headless(m_settings.headless)
+        .enable_validation_layers(m_settings.enable_validation)
+        .use_default_debug_messenger();
+    if (!m_settings.headless)
+    {
+        instance_builder.enable_extensions(static_cast<size_t>(sdl_extension_count), sdl_extensions);
+    }
+    auto instance_builder_return = instance_builder.build();
 
     if (!instance_builder_return)
     {
@@ -289,10 +588,29 @@ void Renderer::pick_physical_device()
     VkPhysicalDeviceVulkan12Features features12 = {};
     features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
     features12.bufferDeviceAddress = true;
+    features12.timelineSemaphore = true;
+    features12.drawIndirectCount = true;
+    // Bindless table: partially bound runtime arrays that can be written while a frame using them is in flight
+    features12.descriptorIndexing = true;
+    features12.runtimeDescriptorArray = true;
+    features12.descriptorBindingPartiallyBound = true;
+    features12.descriptorBindingSampledImageUpdateAfterBind = true;
+    features12.descriptorBindingStorageImageUpdateAfterBind = true;
+    features12.descriptorBindingStorageBufferUpdateAfterBind = true;
+    features12.descriptorBindingUpdateUnusedWhilePending = true;
+    features12.shaderSampledImageArrayNonUniformIndexing = true;
+
+    // The cull pass points firstInstance at each draw's slot in the visible list
+    VkPhysicalDeviceFeatures features = {};
+    features.drawIndirectFirstInstance = true;
 
     vkb::PhysicalDeviceSelector selector{ m_instance };
-    auto phys_ret = selector.set_surface(m_surface)
-                        .prefer_gpu_device_type(vkb::PreferredDeviceType::discrete)
+    if (!m_settings.headless)
+    {
+        selector.set_surface(m_surface);
+    }
+    auto phys_ret = selector.prefer_gpu_device_type(vkb::PreferredDeviceType::discrete)
+                        .set_required_features(features)
                         .set_required_features_12(features12)
                         .set_required_features_13(features13)
                         .select();
@@ -315,9 +633,20 @@ void Renderer::pick_physical_device()
     }
 
     m_physical_device = phys_ret.value();
-    if (!m_physical_device.enable_extension_if_present(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME))
+    m_descriptor_buffer_supported = false;
+    if (m_settings.use_descriptor_buffer &&
+        m_physical_device.enable_extension_if_present(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME))
+    {
+        VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptor_buffer_features = {};
+        descriptor_buffer_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
+        descriptor_buffer_features.descriptorBuffer = true;
+        m_descriptor_buffer_supported =
+            m_physical_device.enable_extension_features_if_present(descriptor_buffer_features);
+    }
+    if (m_settings.use_descriptor_buffer && !m_descriptor_buffer_supported)
     {
-        std::cerr << VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME << " not present!" << std::endl;
+        std::cerr << VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME << " not supported, falling back to descriptor indexing"
+                  << std::endl;
     }
 }
 
@@ -331,6 +660,38 @@ void Renderer::create_device()
     }
     m_device = dev_ret.value();
     m_deletion_queue.push_function([this]() { vkb::destroy_device(m_device); });
+
+    // vkb only hands out a compute queue from a family without graphics, which is what async compute needs
+    auto compute_queue_ret = m_device.get_queue(vkb::QueueType::compute);
+    if (compute_queue_ret)
+    {
+        m_compute_queue = compute_queue_ret.value();
+        m_compute_queue_family = m_device.get_queue_index(vkb::QueueType::compute).value();
+        std::println("Async compute queue family: {}", m_compute_queue_family);
+    }
+    else
+    {
+        std::println("No separate compute queue family, compute stays on the graphics queue");
+    }
+}
+
+void Renderer::init_thread_pool()
+{
+    m_thread_pool.init();
+    m_deletion_queue.push_function([this]() { m_thread_pool.destroy(); });
+}
+
+void Renderer::init_pipeline_cache()
+{
+    m_pipeline_cache.init(m_device, m_physical_device, "pipeline_cache.bin");
+    m_pipeline_compiler.init(&m_pipeline_cache, &m_thread_pool);
+    m_deletion_queue.push_function(
+        [this]()
+        {
+            m_pipeline_compiler.wait_idle();
+            m_pipeline_cache.save();
+            m_pipeline_cache.destroy();
+        });
 }
 
 void Renderer::create_swapchain()
@@ -338,7 +699,8 @@ void Renderer::create_swapchain()
     vkb::SwapchainBuilder swapchain_builder{ m_device };
     auto swap_builder_ret =
         swapchain_builder.set_old_swapchain(m_swapchain_data.swapchain)
-            .set_desired_min_image_count(3)
+            .set_desired_present_mode(m_settings.present_mode)
+            .set_desired_min_image_count(m_frames_in_flight + 1)
             .set_desired_extent(m_window_extent.width, m_window_extent.height)
             .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
             .build();
@@ -349,23 +711,68 @@ void Renderer::create_swapchain()
         return;
     }
 
-    vkb::destroy_swapchain(m_swapchain_data.swapchain);
+    if (m_swapchain_data.swapchain.swapchain != VK_NULL_HANDLE)
+    {
+        // Frames in flight may still render to or present the old images
+        for (VkImage image : m_swapchain_data.swapchain_images)
+        {
+            m_render_graph.forget(image);
+        }
+        m_timeline_deletion_queue.push_function(
+            [old_swapchain = m_swapchain_data.swapchain, old_views = m_swapchain_data.swapchain_image_views]() mutable
+            {
+                old_swapchain.destroy_image_views(old_views);
+                vkb::destroy_swapchain(old_swapchain);
+            });
+    }
     m_swapchain_data.swapchain = swap_builder_ret.value();
     m_swapchain_data.swapchain_images = m_swapchain_data.swapchain.get_images().value();
     m_swapchain_data.swapchain_image_views = m_swapchain_data.swapchain.get_image_views().value();
     m_swapchain_data.swapchain_extent_2D = m_window_extent;
+    if (m_swapchain_data.swapchain.present_mode != m_settings.present_mode)
+    {
+        std::println("Present mode {} unsupported, using {}",
+                     string_VkPresentModeKHR(m_settings.present_mode),
+                     string_VkPresentModeKHR(m_swapchain_data.swapchain.present_mode));
+    }
 }
 
 void Renderer::recreate_swapchain()
 {
-    vkDeviceWaitIdle(m_device);
-
-    m_swapchain_data.swapchain.destroy_image_views(m_swapchain_data.swapchain_image_views);
-    destroy_draw_image(m_swapchain_data.draw_image);
-    destroy_image(m_swapchain_data.depth_image);
+    // Nothing waits for the GPU here: whatever gets replaced is retired through the timeline deletion queue
     create_swapchain();
-    create_draw_image();
-    create_depth_image();
+    // A new present mode or frame count can change the image count, and each image needs its submit semaphore
+    VkSemaphoreCreateInfo semaphore_info = init::semaphore_create_info();
+    while (m_submit_semaphores.size() < m_swapchain_data.swapchain_images.size())
+    {
+        VK_CHECK(vkCreateSemaphore(m_device, &semaphore_info, nullptr, &m_submit_semaphores.emplace_back()));
+    }
+    resize_render_targets();
+    resize_depth_pyramid();
+}
+
+void Renderer::recreate_render_targets()
+{
+    retire_render_targets();
+    create_render_targets();
+    resize_depth_pyramid();
+    m_render_targets_dirty = false;
+}
+
+void Renderer::resize_depth_pyramid()
+{
+    const VkImage old_image = m_depth_pyramid.get_image();
+    m_depth_pyramid.resize(
+        m_swapchain_data.depth_image.image_view, m_swapchain_data.draw_extent_2D, m_timeline_deletion_queue);
+    if (m_depth_pyramid.get_image() != old_image)
+    {
+        m_render_graph.forget(old_image);
+        m_timeline_deletion_queue.push_function(
+            [this, index = m_depth_pyramid_texture]()
+            { m_bindless_table.remove(BindlessBinding::SampledImage, index); });
+        m_depth_pyramid_texture =
+            m_bindless_table.add_sampled_image(m_depth_pyramid.get_view(), VK_IMAGE_LAYOUT_GENERAL);
+    }
 }
 
 void Renderer::init_vma()
@@ -388,6 +795,43 @@ void Renderer::init_vma()
     m_deletion_queue.push_function([this]() { vmaDestroyAllocator(m_vma_allocator); });
 }
 
+void Renderer::init_staging_ring()
+{
+    m_staging_ring.init(m_device,
+                        m_vma_allocator,
+                        STAGING_RING_PARTITION_SIZE,
+                        STAGING_RING_FRAME_REGION_SIZE,
+                        m_frames_in_flight);
+    m_deletion_queue.push_function([this]() { m_staging_ring.destroy(); });
+}
+
+void Renderer::init_uploader()
+{
+    // Prefer a transfer-only family, then any non-graphics family with transfer support, then share graphics
+    uint32_t queue_family_index = m_device.get_queue_index(vkb::QueueType::graphics).value();
+    VkQueue queue = m_device.get_queue(vkb::QueueType::graphics).value();
+    std::mutex* queue_mutex = &m_graphics_queue_mutex;
+
+    auto dedicated_queue_index = m_device.get_dedicated_queue_index(vkb::QueueType::transfer);
+    auto separate_queue_index = m_device.get_queue_index(vkb::QueueType::transfer);
+    if (dedicated_queue_index)
+    {
+        queue_family_index = dedicated_queue_index.value();
+        queue = m_device.get_dedicated_queue(vkb::QueueType::transfer).value();
+        queue_mutex = nullptr;
+    }
+    else if (separate_queue_index)
+    {
+        queue_family_index = separate_queue_index.value();
+        queue = m_device.get_queue(vkb::QueueType::transfer).value();
+        queue_mutex = nullptr;
+    }
+    std::println("Uploader queue family: {}{}", queue_family_index, queue_mutex ? " (shared with graphics)" : "");
+
+    m_uploader.init(m_device, m_vma_allocator, &m_staging_ring, queue_family_index, queue, queue_mutex);
+    m_deletion_queue.push_function([this]() { m_uploader.destroy(); });
+}
+
 AllocatedBuffer Renderer::create_buffer(size_t alloc_size, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage)
 {
     VkBufferCreateInfo buffer_info = {};
@@ -396,6 +840,16 @@ AllocatedBuffer Renderer::create_buffer(size_t alloc_size, VkBufferUsageFlags us
     buffer_info.size = alloc_size;
     buffer_info.usage = usage;
 
+    // Transfer destinations may be written by the uploader's queue, so share them instead of transferring ownership
+    const std::array<uint32_t, 2> queue_families = { m_device.get_queue_index(vkb::QueueType::graphics).value(),
+                                                     m_uploader.get_queue_family_index() };
+    if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && queue_families[0] != queue_families[1])
+    {
+        buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buffer_info.queueFamilyIndexCount = static_cast<uint32_t>(queue_families.size());
+        buffer_info.pQueueFamilyIndices = queue_families.data();
+    }
+
     VmaAllocationCreateInfo vma_alloc_info = {};
     vma_alloc_info.usage = memory_usage;
     vma_alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
@@ -411,107 +865,127 @@ void Renderer::destroy_buffer(AllocatedBuffer& buffer)
     vmaDestroyBuffer(m_vma_allocator, buffer.buffer, buffer.allocation);
 }
 
-void Renderer::create_draw_image()
+void Renderer::init_render_targets()
 {
-    VkExtent3D draw_image_extent = { m_swapchain_data.swapchain_extent_2D.width,
-                                     m_swapchain_data.swapchain_extent_2D.height,
-                                     1 };
-
-    m_swapchain_data.draw_image.image_format = VK_FORMAT_R16G16B16A16_SFLOAT;
-    m_swapchain_data.draw_image.image_extent = draw_image_extent;
-
-    VkImageUsageFlags draw_image_usages = {};
-    draw_image_usages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-    draw_image_usages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-    draw_image_usages |= VK_IMAGE_USAGE_STORAGE_BIT;
-    draw_image_usages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-
-    m_swapchain_data.draw_extent_2D = m_swapchain_data.swapchain_extent_2D;
+    std::vector<uint32_t> queue_families = { m_device.get_queue_index(vkb::QueueType::graphics).value() };
+    if (m_compute_queue != VK_NULL_HANDLE)
+    {
+        queue_families.push_back(m_compute_queue_family);
+    }
+    m_transient_allocator.init(m_device, m_vma_allocator, std::move(queue_families));
+
+    TransientImageDesc draw_image_desc = {};
+    draw_image_desc.name = "draw";
+    draw_image_desc.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    draw_image_desc.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    draw_image_desc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    // The background may write it from the async compute queue
+    draw_image_desc.concurrent = true;
+    m_draw_image_target = m_transient_allocator.add_image(draw_image_desc);
+
+    TransientImageDesc depth_image_desc = {};
+    depth_image_desc.name = "depth";
+    depth_image_desc.format = VK_FORMAT_D32_SFLOAT;
+    // Sampled by the depth pyramid reduction
+    depth_image_desc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    depth_image_desc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    m_depth_image_target = m_transient_allocator.add_image(depth_image_desc);
+
+    resize_render_targets();
+}
 
-    VkImageCreateInfo render_img_info =
-        init::image_create_info(m_swapchain_data.draw_image.image_format, draw_image_usages, draw_image_extent);
+void Renderer::resize_render_targets()
+{
+    const VkExtent2D extent = m_swapchain_data.swapchain_extent_2D;
+    if (extent.width > m_render_target_extent.width || extent.height > m_render_target_extent.height)
+    {
+        // Grow to a high-water mark. Past the first allocation leave some slack, so dragging a window edge
+        // doesn't reallocate every frame; shrinking only renders into a smaller part of the targets.
+        constexpr uint32_t SLACK = 128;
+        const bool first_allocation = m_render_target_extent.width == 0;
+        auto grow = [first_allocation](uint32_t current, uint32_t requested)
+        { return std::max(current, first_allocation ? requested : (requested + SLACK - 1) / SLACK * SLACK); };
+        m_render_target_extent = { grow(m_render_target_extent.width, extent.width),
+                                   grow(m_render_target_extent.height, extent.height) };
+        if (!first_allocation)
+        {
+            retire_render_targets();
+        }
+        create_render_targets();
+    }
+    m_swapchain_data.draw_extent_2D = m_dynamic_resolution.scale_extent(extent);
+}
 
-    VmaAllocationCreateInfo render_img_alloc_info = {};
-    render_img_alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-    render_img_alloc_info.requiredFlags = static_cast<VkMemoryPropertyFlags>(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+void Renderer::update_draw_extent()
+{
+    if (!m_settings.dynamic_resolution)
+    {
+        m_dynamic_resolution.reset();
+    }
+    // The blit to the swapchain stretches whatever part of the draw image was rendered
+    const VkExtent2D extent = m_dynamic_resolution.scale_extent(m_swapchain_data.swapchain_extent_2D);
+    if (extent.width != m_swapchain_data.draw_extent_2D.width ||
+        extent.height != m_swapchain_data.draw_extent_2D.height)
+    {
+        m_swapchain_data.draw_extent_2D = extent;
+        resize_depth_pyramid();
+    }
+}
 
-    vmaCreateImage(m_vma_allocator,
-                   &render_img_info,
-                   &render_img_alloc_info,
-                   &m_swapchain_data.draw_image.image,
-                   &m_swapchain_data.draw_image.allocation,
-                   nullptr);
+void Renderer::create_render_targets()
+{
+    const VkExtent3D extent = { m_render_target_extent.width, m_render_target_extent.height, 1 };
+    for (uint32_t target = 0; target < m_transient_allocator.get_image_count(); target++)
+    {
+        m_transient_allocator.set_extent(target, extent);
+    }
+    m_transient_allocator.allocate();
 
-    VkImageViewCreateInfo render_view_info = init::image_view_create_info(
-        m_swapchain_data.draw_image.image_format, m_swapchain_data.draw_image.image, VK_IMAGE_ASPECT_COLOR_BIT);
-    VK_CHECK(vkCreateImageView(m_device, &render_view_info, nullptr, &m_swapchain_data.draw_image.image_view));
+    m_swapchain_data.draw_image = m_transient_allocator.get_image(m_draw_image_target);
+    m_swapchain_data.depth_image = m_transient_allocator.get_image(m_depth_image_target);
 
     std::println("Draw image created\n\twidth: {}\n\theigth: {}",
                  m_swapchain_data.draw_image.image_extent.width,
                  m_swapchain_data.draw_image.image_extent.height);
 
-    VkDescriptorSetAllocateInfo descriptor_alloc_info = {};
-    descriptor_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptor_alloc_info.pNext = nullptr;
-    descriptor_alloc_info.descriptorPool = m_compute_descriptor_pool;
-    descriptor_alloc_info.descriptorSetCount = 1;
-    descriptor_alloc_info.pSetLayouts = &m_compute_descriptor_layout;
-    VK_CHECK(vkAllocateDescriptorSets(m_device, &descriptor_alloc_info, &m_compute_descriptor_set));
-
-    VkDescriptorImageInfo image_info = {};
-    image_info.sampler = VK_NULL_HANDLE;                           // storage image, no sampler
-    image_info.imageView = m_swapchain_data.draw_image.image_view; // your created view
-    image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;              // matches how you use it
-
-    VkWriteDescriptorSet write = {};
-    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    write.dstSet = m_compute_descriptor_set;
-    write.dstBinding = 0;
-    write.dstArrayElement = 0;
-    write.descriptorCount = 1;
-    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    write.pImageInfo = &image_info;
-
-    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+    m_compute_push_constants.image = m_bindless_table.add_storage_image(m_swapchain_data.draw_image.image_view);
 }
 
-void Renderer::create_depth_image()
+void Renderer::retire_render_targets()
 {
-    m_swapchain_data.depth_image.image_format = VK_FORMAT_D32_SFLOAT;
-    m_swapchain_data.depth_image.image_extent = m_swapchain_data.draw_image.image_extent;
-
-    VkImageUsageFlags depth_image_usages = {};
-    depth_image_usages |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-    VkImageCreateInfo depth_img_info = init::image_create_info(
-        m_swapchain_data.depth_image.image_format, depth_image_usages, m_swapchain_data.draw_image.image_extent);
-
-    VmaAllocationCreateInfo render_img_alloc_info = {};
-    render_img_alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-    render_img_alloc_info.requiredFlags = static_cast<VkMemoryPropertyFlags>(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    vmaCreateImage(m_vma_allocator,
-                   &depth_img_info,
-                   &render_img_alloc_info,
-                   &m_swapchain_data.depth_image.image,
-                   &m_swapchain_data.depth_image.allocation,
-                   nullptr);
-
-    VkImageViewCreateInfo depth_view_info = init::image_view_create_info(
-        m_swapchain_data.depth_image.image_format, m_swapchain_data.depth_image.image, VK_IMAGE_ASPECT_DEPTH_BIT);
-    VK_CHECK(vkCreateImageView(m_device, &depth_view_info, nullptr, &m_swapchain_data.depth_image.image_view));
-}
-
-void Renderer::destroy_image(AllocatedImage& img)
-{
-    vkDestroyImageView(m_device, img.image_view, nullptr);
-    vmaDestroyImage(m_vma_allocator, img.image, img.allocation);
+    for (uint32_t target = 0; target < m_transient_allocator.get_image_count(); target++)
+    {
+        m_render_graph.forget(m_transient_allocator.get_image(target).image);
+    }
+    m_transient_allocator.retire(m_timeline_deletion_queue);
+    m_swapchain_data.draw_image = {};
+    m_swapchain_data.depth_image = {};
+    m_timeline_deletion_queue.push_function(
+        [this, index = m_compute_push_constants.image]()
+        { m_bindless_table.remove(BindlessBinding::StorageImage, index); });
+    m_compute_push_constants.image = BindlessTable::INVALID_INDEX;
 }
 
-void Renderer::destroy_draw_image(AllocatedImage& img)
+void Renderer::update_render_target_lifetimes()
 {
-    destroy_image(img);
-    vkResetDescriptorPool(m_device, m_compute_descriptor_pool, 0);
+    for (uint32_t target = 0; target < m_transient_allocator.get_image_count(); target++)
+    {
+        uint32_t first_pass = 0;
+        uint32_t last_pass = 0;
+        if (m_render_graph.get_lifetime(m_transient_allocator.get_image(target).image, first_pass, last_pass))
+        {
+            if (target == m_draw_image_target && use_async_compute())
+            {
+                // Written on the compute queue before any graph pass runs
+                first_pass = 0;
+            }
+            m_transient_allocator.set_lifetime(target, first_pass, last_pass);
+        }
+    }
+    // Re-placing allocates new memory while the old targets are retired, so only do it when the frame's shape
+    // actually changed
+    m_render_targets_dirty = m_transient_allocator.is_placement_stale();
 }
 
 void Renderer::create_command_buffers()
@@ -522,7 +996,7 @@ void Renderer::create_command_buffers()
     command_info.queueFamilyIndex = m_device.get_queue_index(vkb::QueueType::graphics).value();
     command_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-    for (auto& frame : m_frame_data)
+    for (auto& frame : std::span(m_frame_data).first(m_frames_in_flight))
     {
         VK_CHECK(vkCreateCommandPool(m_device, &command_info, nullptr, &frame.command_pool));
 
@@ -534,48 +1008,69 @@ void Renderer::create_command_buffers()
         alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
         VK_CHECK(vkAllocateCommandBuffers(m_device, &alloc_info, &frame.command_buffer));
+
+        frame.compute_command_pool = VK_NULL_HANDLE;
+        frame.compute_command_buffer = VK_NULL_HANDLE;
+        if (m_compute_queue != VK_NULL_HANDLE)
+        {
+            VkCommandPoolCreateInfo compute_command_info = command_info;
+            compute_command_info.queueFamilyIndex = m_compute_queue_family;
+            VK_CHECK(vkCreateCommandPool(m_device, &compute_command_info, nullptr, &frame.compute_command_pool));
+            alloc_info.commandPool = frame.compute_command_pool;
+            VK_CHECK(vkAllocateCommandBuffers(m_device, &alloc_info, &frame.compute_command_buffer));
+        }
+
+        // Reset as a whole by the job recording into them, so no per-buffer reset
+        frame.recording_command_pools.assign(m_max_recording_threads > 1 ? m_max_recording_threads : 0,
+                                             VK_NULL_HANDLE);
+        frame.recording_command_buffers.assign(frame.recording_command_pools.size(), VK_NULL_HANDLE);
+        VkCommandPoolCreateInfo recording_command_info = command_info;
+        recording_command_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        for (size_t i = 0; i < frame.recording_command_pools.size(); i++)
+        {
+            VK_CHECK(
+                vkCreateCommandPool(m_device, &recording_command_info, nullptr, &frame.recording_command_pools[i]));
+            VkCommandBufferAllocateInfo secondary_alloc_info = alloc_info;
+            secondary_alloc_info.commandPool = frame.recording_command_pools[i];
+            secondary_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            VK_CHECK(vkAllocateCommandBuffers(m_device, &secondary_alloc_info, &frame.recording_command_buffers[i]));
+        }
     }
 
     m_deletion_queue.push_function(
         [this]()
         {
-            for (size_t i = 0; i < m_frame_data.size(); i++)
+            for (size_t i = 0; i < m_frames_in_flight; i++)
             {
                 vkDestroyCommandPool(m_device, m_frame_data[i].command_pool, nullptr);
+                if (m_frame_data[i].compute_command_pool != VK_NULL_HANDLE)
+                {
+                    vkDestroyCommandPool(m_device, m_frame_data[i].compute_command_pool, nullptr);
+                }
+                for (VkCommandPool pool : m_frame_data[i].recording_command_pools)
+                {
+                    vkDestroyCommandPool(m_device, pool, nullptr);
+                }
             }
         });
-
-    // Immediate Cmd Buffer
-    VK_CHECK(vkCreateCommandPool(m_device, &command_info, nullptr, &m_imm_command_pool));
-    VkCommandBufferAllocateInfo cmd_alloc_info = init::command_buffer_allocate_info(m_imm_command_pool, 1);
-    VK_CHECK(vkAllocateCommandBuffers(m_device, &cmd_alloc_info, &m_imm_command_buffer));
-
-    m_deletion_queue.push_function([this]() { vkDestroyCommandPool(m_device, m_imm_command_pool, nullptr); });
 }
 
 void Renderer::init_sync_structures()
 {
-    VkFenceCreateInfo fence_info = {};
-    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fence_info.pNext = nullptr;
-    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
     VkSemaphoreCreateInfo semaphore_info = {};
     semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     semaphore_info.pNext = nullptr;
 
-    for (auto& frame : m_frame_data)
+    for (auto& frame : std::span(m_frame_data).first(m_frames_in_flight))
     {
-        VK_CHECK(vkCreateFence(m_device, &fence_info, nullptr, &frame.render_fence));
         VK_CHECK(vkCreateSemaphore(m_device, &semaphore_info, nullptr, &frame.acquire_semaphore));
     }
 
     m_deletion_queue.push_function(
         [this]()
         {
-            for (size_t i = 0; i < m_frame_data.size(); i++)
+            for (size_t i = 0; i < m_frames_in_flight; i++)
             {
-                vkDestroyFence(m_device, m_frame_data[i].render_fence, nullptr);
                 vkDestroySemaphore(m_device, m_frame_data[i].acquire_semaphore, nullptr);
             }
         });
@@ -589,65 +1084,88 @@ void Renderer::init_sync_structures()
     m_deletion_queue.push_function(
         [this]()
         {
-            for (size_t i = 0; i < m_swapchain_data.swapchain_images.size(); i++)
+            for (VkSemaphore semaphore : m_submit_semaphores)
             {
-                vkDestroySemaphore(m_device, m_submit_semaphores[i], nullptr);
+                vkDestroySemaphore(m_device, semaphore, nullptr);
             }
         });
 
-    // Immediate Fence
-    VK_CHECK(vkCreateFence(m_device, &fence_info, nullptr, &m_imm_fence));
-    m_deletion_queue.push_function([this]() { vkDestroyFence(m_device, m_imm_fence, nullptr); });
+    VkSemaphoreTypeCreateInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timeline_info.pNext = nullptr;
+    timeline_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timeline_info.initialValue = 0;
+    VkSemaphoreCreateInfo timeline_semaphore_info = semaphore_info;
+    timeline_semaphore_info.pNext = &timeline_info;
+    VK_CHECK(vkCreateSemaphore(m_device, &timeline_semaphore_info, nullptr, &m_async_compute_semaphore));
+    m_deletion_queue.push_function([this]() { vkDestroySemaphore(m_device, m_async_compute_semaphore, nullptr); });
+
+    m_timeline.init(m_device);
+    m_deletion_queue.push_function([this]() { m_timeline.destroy(); });
 }
 
-void Renderer::init_descriptors()
+void Renderer::init_gpu_profiler()
 {
-    VkDescriptorSetLayoutBinding layout_binding = {};
-    layout_binding.binding = 0;
-    layout_binding.descriptorCount = 1;
-    layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    layout_binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-    layout_binding.pImmutableSamplers = nullptr;
-
-    std::vector<VkDescriptorSetLayoutBinding> descriptor_layout_bindings;
-    descriptor_layout_bindings.push_back(layout_binding);
-
-    VkDescriptorSetLayoutCreateInfo layout_info = {};
-    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layout_info.pNext = nullptr;
-    layout_info.bindingCount = (uint32_t)descriptor_layout_bindings.size();
-    layout_info.pBindings = descriptor_layout_bindings.data();
-    vkCreateDescriptorSetLayout(m_device, &layout_info, nullptr, &m_compute_descriptor_layout);
-    m_deletion_queue.push_function([this]()
-                                   { vkDestroyDescriptorSetLayout(m_device, m_compute_descriptor_layout, nullptr); });
-
-    std::vector<VkDescriptorPoolSize> pool_sizes = { { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 } };
+    m_gpu_profiler.init(m_device,
+                        m_physical_device,
+                        m_device.get_queue_index(vkb::QueueType::graphics).value(),
+                        m_frames_in_flight);
+    m_deletion_queue.push_function([this]() { m_gpu_profiler.destroy(); });
 
-    VkDescriptorPoolCreateInfo pool_info = {};
-    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    pool_info.pNext = nullptr;
-    pool_info.pPoolSizes = pool_sizes.data();
-    pool_info.poolSizeCount = (uint32_t)pool_sizes.size();
-    pool_info.maxSets = 1;
-    VK_CHECK(vkCreateDescriptorPool(m_device, &pool_info, nullptr, &m_compute_descriptor_pool));
-    m_deletion_queue.push_function([this]() { vkDestroyDescriptorPool(m_device, m_compute_descriptor_pool, nullptr); });
+    if (m_compute_queue != VK_NULL_HANDLE)
+    {
+        m_compute_profiler.init(m_device, m_physical_device, m_compute_queue_family, m_frames_in_flight);
+        m_deletion_queue.push_function([this]() { m_compute_profiler.destroy(); });
+    }
 }
 
-void Renderer::init_triangle_pipeline()
+bool Renderer::collect_gpu_timings(uint32_t frame_slot)
 {
-    VkShaderModule triangle_frag_shader;
-    if (!util::load_shader_module("shaders/colored_triangle.frag.spv", m_device, &triangle_frag_shader))
+    // A frame whose timestamps were unavailable leaves the previous time behind, which must not be counted again
+    const bool collected =
+        m_gpu_profiler.collect(frame_slot) && m_gpu_profiler.get_collected_ms("Frame", m_last_gpu_frame_ms);
+    if (collected)
+    {
+        m_last_background_ms = m_gpu_profiler.get_last_ms("Background");
+    }
+    // The slot's graphics submit waited on its async dispatch, so that is done as well
+    if (m_compute_queue != VK_NULL_HANDLE && m_compute_profiler.collect(frame_slot) && use_async_compute())
     {
-        std::cerr << "Error when building the triangle fragment shader module" << std::endl;
+        m_last_background_ms = m_compute_profiler.get_last_ms("Background");
     }
+    return collected;
+}
 
-    VkShaderModule triangle_vertex_shader;
-    // if (!util::load_shader_module("shaders/colored_triangle.vert.spv", m_device, &triangle_vertex_shader))
-    if (!util::load_shader_module("shaders/colored_triangle_mesh.vert.spv", m_device, &triangle_vertex_shader))
+bool Renderer::dump_gpu_profile(const char* file_path) const
+{
+    return m_gpu_profiler.dump_csv(file_path);
+}
+
+void Renderer::init_descriptors()
+{
+    m_bindless_table.init(m_device, m_physical_device, m_vma_allocator, m_descriptor_buffer_supported);
+    m_deletion_queue.push_function([this]() { m_bindless_table.destroy(); });
+
+    constexpr std::array<DescriptorPoolSizeRatio, 2> FRAME_POOL_RATIOS = { {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+    } };
+    for (auto& frame : std::span(m_frame_data).first(m_frames_in_flight))
     {
-        std::cerr << "Error when building the triangle vertex shader module" << std::endl;
+        frame.descriptor_allocator.init(m_device, FRAME_DESCRIPTOR_SETS, FRAME_POOL_RATIOS);
     }
+    m_deletion_queue.push_function(
+        [this]()
+        {
+            for (auto& frame : std::span(m_frame_data).first(m_frames_in_flight))
+            {
+                frame.descriptor_allocator.destroy();
+            }
+        });
+}
 
+void Renderer::init_triangle_pipeline()
+{
     VkPushConstantRange buffer_range = {};
     buffer_range.offset = 0;
     buffer_range.size = sizeof(GPUDrawPushConstants);
@@ -661,28 +1179,57 @@ void Renderer::init_triangle_pipeline()
     // pipeline_layout_info.setLayoutCount = 1;
     VK_CHECK(vkCreatePipelineLayout(m_device, &pipeline_layout_info, nullptr, &m_triangle_pipeline_layout));
 
-    PipelineBuilder pipelineBuilder;
-    pipelineBuilder.pipeline_layout = m_triangle_pipeline_layout;
-    pipelineBuilder.set_shaders(triangle_vertex_shader, triangle_frag_shader);
-    pipelineBuilder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-    pipelineBuilder.set_polygon_mode(VK_POLYGON_MODE_FILL);
-    pipelineBuilder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE);
-    pipelineBuilder.set_multisampling_none();
-    pipelineBuilder.disable_blending();
-    pipelineBuilder.enable_depth_test(true, VK_COMPARE_OP_GREATER_OR_EQUAL);
-    // pipelineBuilder.disable_depth_test();
-    pipelineBuilder.set_color_attachment_format(m_swapchain_data.draw_image.image_format);
-    pipelineBuilder.set_depth_format(m_swapchain_data.depth_image.image_format);
-    m_triangle_pipeline = pipelineBuilder.build_pipeline(m_device);
-
-    vkDestroyShaderModule(m_device, triangle_frag_shader, nullptr);
-    vkDestroyShaderModule(m_device, triangle_vertex_shader, nullptr);
+    // Shader loading and compilation run on the thread pool. draw_triangle skips drawing until it is ready.
+    const VkDevice device = m_device;
+    const VkPipelineLayout layout = m_triangle_pipeline_layout;
+    const VkFormat color_format = m_swapchain_data.draw_image.image_format;
+    const VkFormat depth_format = m_swapchain_data.depth_image.image_format;
+    const char* vertex_shader_path = m_settings.quantized_vertices ? "shaders/colored_triangle_mesh_quantized.vert.spv"
+                                                                   : "shaders/colored_triangle_mesh.vert.spv";
+    m_triangle_pipeline_job = m_pipeline_compiler.enqueue(
+        "triangle",
+        [device, layout, color_format, depth_format, vertex_shader_path](VkPipelineCache pipeline_cache)
+        {
+            VkShaderModule triangle_frag_shader;
+            if (!util::load_shader_module("shaders/colored_triangle.frag.spv", device, &triangle_frag_shader))
+            {
+                std::cerr << "Error when building the triangle fragment shader module" << std::endl;
+                return VkPipeline{ VK_NULL_HANDLE };
+            }
+
+            VkShaderModule triangle_vertex_shader;
+            // if (!util::load_shader_module("shaders/colored_triangle.vert.spv", device, &triangle_vertex_shader))
+            if (!util::load_shader_module(vertex_shader_path, device, &triangle_vertex_shader))
+            {
+                std::cerr << "Error when building the triangle vertex shader module" << std::endl;
+                vkDestroyShaderModule(device, triangle_frag_shader, nullptr);
+                return VkPipeline{ VK_NULL_HANDLE };
+            }
+
+            PipelineBuilder pipelineBuilder;
+            pipelineBuilder.pipeline_layout = layout;
+            pipelineBuilder.set_shaders(triangle_vertex_shader, triangle_frag_shader);
+            pipelineBuilder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+            pipelineBuilder.set_polygon_mode(VK_POLYGON_MODE_FILL);
+            pipelineBuilder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE);
+            pipelineBuilder.set_multisampling_none();
+            pipelineBuilder.disable_blending();
+            pipelineBuilder.enable_depth_test(true, VK_COMPARE_OP_GREATER_OR_EQUAL);
+            // pipelineBuilder.disable_depth_test();
+            pipelineBuilder.set_color_attachment_format(color_format);
+            pipelineBuilder.set_depth_format(depth_format);
+            VkPipeline pipeline = pipelineBuilder.build_pipeline(device, pipeline_cache);
+
+            vkDestroyShaderModule(device, triangle_frag_shader, nullptr);
+            vkDestroyShaderModule(device, triangle_vertex_shader, nullptr);
+            return pipeline;
+        });
 
     m_deletion_queue.push_function(
         [&]()
         {
             vkDestroyPipelineLayout(m_device, m_triangle_pipeline_layout, nullptr);
-            vkDestroyPipeline(m_device, m_triangle_pipeline, nullptr);
+            vkDestroyPipeline(m_device, m_triangle_pipeline_job.get(), nullptr);
         });
 }
 
@@ -696,112 +1243,537 @@ void Renderer::init_compute_pipeline()
     VkPipelineLayoutCreateInfo layout_info = {};
     layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     layout_info.pNext = nullptr;
-    layout_info.pSetLayouts = &m_compute_descriptor_layout;
+    const VkDescriptorSetLayout bindless_layout = m_bindless_table.get_layout();
+    layout_info.pSetLayouts = &bindless_layout;
     layout_info.setLayoutCount = 1;
     layout_info.pPushConstantRanges = &push_constant_range;
     layout_info.pushConstantRangeCount = 1;
     VK_CHECK(vkCreatePipelineLayout(m_device, &layout_info, nullptr, &m_compute_layout));
 
-    VkShaderModule gradient_shader_module = {};
-    if (!util::load_shader_module("shaders/gradient.spv", m_device, &gradient_shader_module))
-    // if (!load_shader_module(m_shader_path.c_str(), m_init_data.device, &gradient_shader_module))
-    {
-        std::cerr << "Failed to load gradient shader" << std::endl;
-        return;
-    }
-
-    VkPipelineShaderStageCreateInfo stage_info = {};
-    stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    stage_info.pNext = nullptr;
-    stage_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-    stage_info.module = gradient_shader_module;
-    stage_info.pName = "main";
-
-    VkComputePipelineCreateInfo compute_pipeline_create_info = {};
-    compute_pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-    compute_pipeline_create_info.pNext = nullptr;
-    compute_pipeline_create_info.layout = m_compute_layout;
-    compute_pipeline_create_info.stage = stage_info;
+    const VkDevice device = m_device;
+    const VkPipelineLayout layout = m_compute_layout;
+    const VkPipelineCreateFlags flags = m_bindless_table.get_pipeline_create_flags();
+    m_compute_pipeline_job = m_pipeline_compiler.enqueue(
+        "gradient",
+        [device, layout, flags](VkPipelineCache pipeline_cache)
+        {
+            VkShaderModule gradient_shader_module = {};
+            if (!util::load_shader_module("shaders/gradient.comp.spv", device, &gradient_shader_module))
+            {
+                std::cerr << "Failed to load gradient shader" << std::endl;
+                return VkPipeline{ VK_NULL_HANDLE };
+            }
 
-    VK_CHECK(vkCreateComputePipelines(
-        m_device, VK_NULL_HANDLE, 1, &compute_pipeline_create_info, nullptr, &m_compute_pipeline));
+            VkPipelineShaderStageCreateInfo stage_info = {};
+            stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            stage_info.pNext = nullptr;
+            stage_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            stage_info.module = gradient_shader_module;
+            stage_info.pName = "main";
+
+            VkComputePipelineCreateInfo compute_pipeline_create_info = {};
+            compute_pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            compute_pipeline_create_info.pNext = nullptr;
+            compute_pipeline_create_info.flags = flags;
+            compute_pipeline_create_info.layout = layout;
+            compute_pipeline_create_info.stage = stage_info;
+
+            VkPipeline pipeline = VK_NULL_HANDLE;
+            VK_CHECK(
+                vkCreateComputePipelines(device, pipeline_cache, 1, &compute_pipeline_create_info, nullptr, &pipeline));
+
+            vkDestroyShaderModule(device, gradient_shader_module, nullptr);
+            return pipeline;
+        });
 
-    vkDestroyShaderModule(m_device, gradient_shader_module, nullptr);
     m_deletion_queue.push_function(
         [this]()
         {
             vkDestroyPipelineLayout(m_device, m_compute_layout, nullptr);
-            vkDestroyPipeline(m_device, m_compute_pipeline, nullptr);
+            vkDestroyPipeline(m_device, m_compute_pipeline_job.get(), nullptr);
         });
 }
 
-void Renderer::draw_triangle(VkCommandBuffer cmd)
+void Renderer::init_cull_pipeline()
 {
-    VkRenderingAttachmentInfo color_attachment = init::color_attachment_info(
-        m_swapchain_data.draw_image.image_view, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-
-    VkRenderingAttachmentInfo depth_attachment =
-        init::depth_attachment_info(m_swapchain_data.depth_image.image_view, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+    VkPushConstantRange push_constant_range = {};
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(GPUCullPushConstants);
+    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-    VkRenderingInfo render_info =
-        init::rendering_info(m_swapchain_data.draw_extent_2D, &color_attachment, &depth_attachment);
-    vkCmdBeginRendering(cmd, &render_info);
+    const VkDescriptorSetLayout bindless_layout = m_bindless_table.get_layout();
+    VkPipelineLayoutCreateInfo layout_info = init::pipeline_layout_create_info();
+    layout_info.pSetLayouts = &bindless_layout;
+    layout_info.setLayoutCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+    layout_info.pushConstantRangeCount = 1;
+    VK_CHECK(vkCreatePipelineLayout(m_device, &layout_info, nullptr, &m_cull_pipeline_layout));
 
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_triangle_pipeline);
+    const VkDevice device = m_device;
+    const VkPipelineLayout layout = m_cull_pipeline_layout;
+    const VkPipelineCreateFlags flags = m_bindless_table.get_pipeline_create_flags();
+    auto enqueue_cull_pipeline = [&](const char* name, const char* shader_path)
+    {
+        return m_pipeline_compiler.enqueue(
+            name,
+            [device, layout, flags, shader_path](VkPipelineCache pipeline_cache)
+            {
+                VkShaderModule cull_shader_module = {};
+                if (!util::load_shader_module(shader_path, device, &cull_shader_module))
+                {
+                    std::cerr << "Failed to load " << shader_path << std::endl;
+                    return VkPipeline{ VK_NULL_HANDLE };
+                }
 
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = m_swapchain_data.draw_image.image_extent.width;
-    viewport.height = m_swapchain_data.draw_image.image_extent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(cmd, 0, 1, &viewport);
+                VkPipelineShaderStageCreateInfo stage_info = {};
+                stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                stage_info.pNext = nullptr;
+                stage_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+                stage_info.module = cull_shader_module;
+                stage_info.pName = "main";
+
+                VkComputePipelineCreateInfo compute_pipeline_create_info = {};
+                compute_pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+                compute_pipeline_create_info.pNext = nullptr;
+                compute_pipeline_create_info.flags = flags;
+                compute_pipeline_create_info.layout = layout;
+                compute_pipeline_create_info.stage = stage_info;
+
+                VkPipeline pipeline = VK_NULL_HANDLE;
+                VK_CHECK(vkCreateComputePipelines(
+                    device, pipeline_cache, 1, &compute_pipeline_create_info, nullptr, &pipeline));
+
+                vkDestroyShaderModule(device, cull_shader_module, nullptr);
+                return pipeline;
+            });
+    };
+    m_cull_pipeline_job = enqueue_cull_pipeline("cull", "shaders/cull_instances.comp.spv");
+    m_meshlet_cull_pipeline_job = enqueue_cull_pipeline("cull meshlets", "shaders/cull_meshlets.comp.spv");
 
-    VkRect2D scissor = {};
-    scissor.offset.x = 0;
-    scissor.offset.y = 0;
-    scissor.extent.width = m_swapchain_data.draw_image.image_extent.width;
-    scissor.extent.height = m_swapchain_data.draw_image.image_extent.height;
-    vkCmdSetScissor(cmd, 0, 1, &scissor);
+    m_deletion_queue.push_function(
+        [this]()
+        {
+            vkDestroyPipelineLayout(m_device, m_cull_pipeline_layout, nullptr);
+            vkDestroyPipeline(m_device, m_cull_pipeline_job.get(), nullptr);
+            vkDestroyPipeline(m_device, m_meshlet_cull_pipeline_job.get(), nullptr);
+        });
+}
 
-    vkCmdBindIndexBuffer(cmd, m_rectangle.index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+void Renderer::init_depth_pyramid()
+{
+    m_depth_pyramid.init(m_device, m_vma_allocator, m_pipeline_compiler);
+    m_depth_pyramid.create(m_swapchain_data.depth_image.image_view, m_swapchain_data.draw_extent_2D);
+    m_depth_pyramid_texture = m_bindless_table.add_sampled_image(m_depth_pyramid.get_view(), VK_IMAGE_LAYOUT_GENERAL);
+    m_depth_pyramid_sampler = m_bindless_table.add_sampler(m_depth_pyramid.get_sampler());
 
-    // m_rectangle_push_constants.world_matrix = glm::mat4{ 1.f };
-    m_rectangle_push_constants.vertex_buffer = m_rectangle.vertex_buffer_address;
-    m_rectangle_push_constants.transform_buffer = m_rectangle.instance_transform_buffer_address;
-    glm::mat4 view = glm::translate(glm::vec3{ 0, 0, -5 });
-    // camera projection
-    glm::mat4 projection =
-        glm::perspective(glm::radians(70.f),
-                         (float)m_swapchain_data.draw_extent_2D.width / (float)m_swapchain_data.draw_extent_2D.height,
-                         10000.f,
-                         0.1f);
+    m_cull_stats_readback = create_buffer(
+        m_frames_in_flight * sizeof(GPUCullStats), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
 
-    // invert the Y direction on projection matrix so that we are more similar
-    // to opengl and gltf axis
-    projection[1][1] *= -1;
-    m_rectangle_push_constants.world_matrix = projection * view;
+    m_deletion_queue.push_function(
+        [this]()
+        {
+            destroy_buffer(m_cull_stats_readback);
+            m_depth_pyramid.destroy();
+        });
+}
+
+bool Renderer::select_culled_geometry()
+{
+    m_culled_geometry = {};
+    if (m_scene.loaded && upload_ready_for_frame(m_scene.buffers.upload) &&
+        upload_ready_for_frame(m_scene.draw_list.upload))
+    {
+        m_culled_geometry.mesh = &m_scene.buffers;
+        m_culled_geometry.draw_list = &m_scene.draw_list;
+        m_culled_geometry.transform_buffer = m_scene.buffers.instance_transform_buffer_address;
+    }
+    else if (upload_ready_for_frame(m_rectangle.upload) && upload_ready_for_frame(m_rectangle_draw_list.upload))
+    {
+        m_culled_geometry.mesh = &m_rectangle;
+        m_culled_geometry.draw_list = &m_rectangle_draw_list;
+        m_culled_geometry.transform_buffer = m_rectangle.instance_transform_buffer_address;
+
+        // Streamed transforms are written straight into this frame's staging ring partition and read by address
+        StagingAllocation transform_allocation = {};
+        const VkDeviceSize transform_bytes = m_rectangle_instance_transforms.size() * sizeof(GPUInstanceTransform);
+        if (m_stream_instance_transforms && m_staging_ring.allocate(transform_bytes, 16, transform_allocation))
+        {
+            const float angle = static_cast<float>(SDL_GetTicks()) / 1000.0f;
+            GPUInstanceTransform* transforms = static_cast<GPUInstanceTransform*>(transform_allocation.mapped);
+            for (size_t i = 0; i < m_rectangle_instance_transforms.size(); i++)
+            {
+                transforms[i] = GPUInstanceTransform::from_matrix(
+                    m_rectangle_instance_transforms[i] *
+                    glm::rotate(angle + static_cast<float>(i), glm::vec3{ 0.0f, 0.0f, 1.0f }));
+            }
+            m_staging_ring.flush(transform_allocation);
+            m_culled_geometry.transform_buffer = transform_allocation.device_address;
+        }
+    }
+    else
+    {
+        return false;
+    }
+    if (m_enable_direct_draws)
+    {
+        // Every item is drawn, so there is nothing for the cull passes to do
+        m_culled_geometry.direct = true;
+        return false;
+    }
+    if (m_cull_pipeline == VK_NULL_HANDLE)
+    {
+        m_cull_pipeline = m_cull_pipeline_job.try_get();
+    }
+    if (m_cull_pipeline == VK_NULL_HANDLE)
+    {
+        // Still compiling
+        m_culled_geometry = {};
+        return false;
+    }
+
+    const GPUDrawList& draw_list = *m_culled_geometry.draw_list;
+    const glm::mat4 view_projection = get_view_projection();
+    if (m_meshlet_cull_pipeline == VK_NULL_HANDLE)
+    {
+        m_meshlet_cull_pipeline = m_meshlet_cull_pipeline_job.try_get();
+    }
+    m_culled_geometry.meshlets = m_enable_meshlet_culling && draw_list.meshlet_index_capacity > 0 &&
+                                 m_meshlet_cull_pipeline != VK_NULL_HANDLE;
+    if (!m_enable_occlusion_culling)
+    {
+        m_depth_pyramid.invalidate();
+    }
+
+    StagingAllocation cull_data_allocation = {};
+    if (!m_staging_ring.allocate(sizeof(GPUCullData), 16, cull_data_allocation))
+    {
+        std::cerr << "Staging ring is full, skipping geometry this frame" << std::endl;
+        m_culled_geometry = {};
+        return false;
+    }
+    GPUCullData* cull_data = static_cast<GPUCullData*>(cull_data_allocation.mapped);
+    cull_data->view_projection = view_projection;
+    cull_data->previous_view_projection = m_previous_view_projection;
+    cull_data->depth_pyramid_size = glm::vec4(m_depth_pyramid.get_extent().width,
+                                              m_depth_pyramid.get_extent().height,
+                                              m_depth_pyramid.get_mip_count(),
+                                              0.0f);
+    cull_data->camera_position = glm::inverse(get_view())[3];
+    cull_data->draw_buffer = draw_list.draw_buffer_address;
+    cull_data->transform_buffer = m_culled_geometry.transform_buffer;
+    cull_data->output_buffer = draw_list.output_buffer_address;
+    cull_data->late_command_buffer = draw_list.output_buffer_address + draw_list.get_late_commands_offset();
+    cull_data->visible_buffer = draw_list.output_buffer_address + draw_list.get_visible_offset();
+    cull_data->candidate_buffer = draw_list.output_buffer_address + draw_list.get_candidate_offset();
+    cull_data->meshlet_buffer = m_culled_geometry.mesh->meshlet_buffer_address;
+    cull_data->index_buffer = m_culled_geometry.mesh->index_buffer_address;
+    cull_data->slot_item_buffer = draw_list.output_buffer_address + draw_list.get_slot_item_offset();
+    cull_data->meshlet_index_buffer = draw_list.meshlet_index_buffer_address;
+    cull_data->meshlet_index_capacity = draw_list.meshlet_index_capacity;
+    cull_data->draw_count = draw_list.draw_count;
+    cull_data->flags = 0;
+    cull_data->depth_pyramid_texture = m_depth_pyramid_texture;
+    cull_data->depth_pyramid_sampler = m_depth_pyramid_sampler;
+    // Pixels per unit at unit depth: half the draw height times the vertical focal length
+    cull_data->lod_scale = m_lod_error_pixels > 0.0f ? std::abs(get_projection()[1][1]) * 0.5f *
+                                                           m_swapchain_data.draw_extent_2D.height / m_lod_error_pixels
+                                                     : 0.0f;
+    if (m_enable_gpu_culling)
+    {
+        cull_data->flags |= CULL_FRUSTUM;
+    }
+    if (m_enable_occlusion_culling)
+    {
+        cull_data->flags |= CULL_OCCLUSION;
+    }
+    if (m_depth_pyramid.is_valid())
+    {
+        cull_data->flags |= CULL_DEPTH_PYRAMID_VALID;
+    }
+    if (m_culled_geometry.meshlets)
+    {
+        cull_data->flags |= CULL_MESHLETS;
+    }
+    m_staging_ring.flush(cull_data_allocation);
+    m_culled_geometry.cull_data = cull_data_allocation.device_address;
+    m_culled_geometry.occlusion = m_enable_occlusion_culling && m_depth_pyramid.is_ready();
+    m_previous_view_projection = view_projection;
+    return true;
+}
 
+void Renderer::cull_geometry(VkCommandBuffer cmd, GPUCullPhase phase)
+{
+    const GPUDrawList& draw_list = *m_culled_geometry.draw_list;
+    GPUCullPushConstants push_constants = {};
+    push_constants.cull_data = m_culled_geometry.cull_data;
+    push_constants.phase = phase;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_pipeline);
+    m_bindless_table.bind(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_pipeline_layout);
+    vkCmdPushConstants(
+        cmd, m_cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullPushConstants), &push_constants);
+    // The late phase only has the early rejects to look at, but their count is only known on the GPU
+    vkCmdDispatch(cmd, (draw_list.draw_count + 63) / 64, 1, 1);
+}
+
+void Renderer::cull_meshlets(VkCommandBuffer cmd, GPUCullPhase phase)
+{
+    GPUCullPushConstants push_constants = {};
+    push_constants.cull_data = m_culled_geometry.cull_data;
+    push_constants.phase = phase;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_meshlet_cull_pipeline);
+    m_bindless_table.bind(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_pipeline_layout);
+    vkCmdPushConstants(
+        cmd, m_cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullPushConstants), &push_constants);
+    // One workgroup per command the instance pass emitted, counted on the GPU
+    vkCmdDispatchIndirect(cmd,
+                          m_culled_geometry.draw_list->output_buffer.buffer,
+                          offsetof(GPUCullStats, meshlet_dispatch) + phase * sizeof(VkDispatchIndirectCommand));
+}
+
+void Renderer::copy_cull_stats(VkCommandBuffer cmd, uint32_t frame_slot)
+{
+    const VkBuffer output_buffer = m_culled_geometry.draw_list->output_buffer.buffer;
+    VkBufferCopy region = {};
+    region.srcOffset = 0;
+    region.dstOffset = frame_slot * sizeof(GPUCullStats);
+    region.size = sizeof(GPUCullStats);
+    vkCmdCopyBuffer(cmd, output_buffer, m_cull_stats_readback.buffer, 1, &region);
+    m_cull_stats_pending[frame_slot] = true;
+}
+
+void Renderer::collect_cull_stats(uint32_t frame_slot)
+{
+    if (!m_cull_stats_pending[frame_slot])
+    {
+        return;
+    }
+    const VkDeviceSize offset = frame_slot * sizeof(GPUCullStats);
+    vmaInvalidateAllocation(m_vma_allocator, m_cull_stats_readback.allocation, offset, sizeof(GPUCullStats));
+    memcpy(&m_cull_stats,
+           static_cast<const uint8_t*>(m_cull_stats_readback.info.pMappedData) + offset,
+           sizeof(GPUCullStats));
+    m_cull_stats_draw_count = m_culled_geometry.draw_list ? m_culled_geometry.draw_list->draw_count : 0;
+    m_cull_stats_pending[frame_slot] = false;
+}
+
+void Renderer::draw_triangle(VkCommandBuffer cmd, GPUCullPhase phase)
+{
+    VkRenderingAttachmentInfo color_attachment = init::color_attachment_info(
+        m_swapchain_data.draw_image.image_view, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+    VkRenderingAttachmentInfo depth_attachment =
+        init::depth_attachment_info(m_swapchain_data.depth_image.image_view, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+    if (phase == CULL_PHASE_LATE)
+    {
+        // Late draws land on top of the early depth
+        depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    }
+
+    VkRenderingInfo render_info =
+        init::rendering_info(m_swapchain_data.draw_extent_2D, &color_attachment, &depth_attachment);
+
+    if (m_triangle_pipeline == VK_NULL_HANDLE)
+    {
+        m_triangle_pipeline = m_triangle_pipeline_job.try_get();
+    }
+    if (m_culled_geometry.direct && m_triangle_pipeline != VK_NULL_HANDLE)
+    {
+        draw_direct(cmd, render_info);
+        return;
+    }
+
+    vkCmdBeginRendering(cmd, &render_info);
+    if (m_triangle_pipeline == VK_NULL_HANDLE || m_culled_geometry.draw_list == nullptr)
+    {
+        // Still compiling or nothing uploaded yet, only clear
+        vkCmdEndRendering(cmd);
+        return;
+    }
+    const GPUDrawList& draw_list = *m_culled_geometry.draw_list;
+    bind_geometry_state(cmd, draw_list.output_buffer_address + draw_list.get_visible_offset());
+
+    // One command per surviving instance primitive, the count comes from the cull pass
+    const bool late = phase == CULL_PHASE_LATE;
+    const VkDeviceSize commands_offset = late ? draw_list.get_late_commands_offset() : GPUDrawList::COMMANDS_OFFSET;
+    const VkDeviceSize count_offset =
+        late ? offsetof(GPUCullStats, late_draw_count) : offsetof(GPUCullStats, early_draw_count);
+    vkCmdDrawIndexedIndirectCount(cmd,
+                                  draw_list.output_buffer.buffer,
+                                  commands_offset,
+                                  draw_list.output_buffer.buffer,
+                                  count_offset,
+                                  draw_list.draw_count,
+                                  sizeof(VkDrawIndexedIndirectCommand));
+
+    vkCmdEndRendering(cmd);
+}
+
+void Renderer::bind_geometry_state(VkCommandBuffer cmd, VkDeviceAddress visible_buffer)
+{
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_triangle_pipeline);
+
+    VkViewport viewport = {};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = m_swapchain_data.draw_extent_2D.width;
+    viewport.height = m_swapchain_data.draw_extent_2D.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+    VkRect2D scissor = {};
+    scissor.offset.x = 0;
+    scissor.offset.y = 0;
+    scissor.extent = m_swapchain_data.draw_extent_2D;
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+    const GPUMeshBuffers& mesh = *m_culled_geometry.mesh;
+    if (m_culled_geometry.meshlets)
+    {
+        // Every command points into the stream of surviving meshlet triangles
+        vkCmdBindIndexBuffer(cmd, m_culled_geometry.draw_list->meshlet_index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+    }
+    else
+    {
+        vkCmdBindIndexBuffer(cmd, mesh.index_buffer.buffer, 0, mesh.index_type);
+    }
+
+    GPUDrawPushConstants push_constants = {};
+    push_constants.world_matrix = get_view_projection();
+    push_constants.vertex_buffer = mesh.vertex_buffer_address;
+    push_constants.transform_buffer = m_culled_geometry.transform_buffer;
+    push_constants.visible_buffer = visible_buffer;
+    push_constants.mesh_quantization_buffer = mesh.mesh_quantization_buffer_address;
+    push_constants.instance_mesh_buffer = mesh.instance_mesh_buffer_address;
     vkCmdPushConstants(cmd,
                        m_triangle_pipeline_layout,
                        VK_SHADER_STAGE_VERTEX_BIT,
                        0,
                        sizeof(GPUDrawPushConstants),
-                       &m_rectangle_push_constants);
+                       &push_constants);
+}
 
-    // vkCmdDraw(cmd, 3, 1, 0, 0);
-    vkCmdDrawIndexed(cmd, 6, 10, 0, 0, 0);
-    // vkCmdDrawIndexed(cmd, 6, 1, 0, 0, 0);
+void Renderer::draw_direct(VkCommandBuffer cmd, VkRenderingInfo render_info)
+{
+    const auto recording_start = std::chrono::steady_clock::now();
+    const std::span<const GPUDrawItem> items = m_culled_geometry.draw_list->draw_items;
+    const uint32_t range_count =
+        std::clamp(std::min(m_recording_threads, static_cast<uint32_t>(items.size())), 1u, m_max_recording_threads);
 
-    vkCmdEndRendering(cmd);
+    if (range_count == 1)
+    {
+        vkCmdBeginRendering(cmd, &render_info);
+        record_direct_draws(cmd, items, 0);
+        vkCmdEndRendering(cmd);
+    }
+    else
+    {
+        // Secondaries inherit nothing but the attachment formats, so each range binds the full state again
+        FrameData& frame = get_current_frame();
+        const VkFormat color_format = m_swapchain_data.draw_image.image_format;
+        VkCommandBufferInheritanceRenderingInfo inheritance_rendering_info = {};
+        inheritance_rendering_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+        inheritance_rendering_info.colorAttachmentCount = 1;
+        inheritance_rendering_info.pColorAttachmentFormats = &color_format;
+        inheritance_rendering_info.depthAttachmentFormat = m_swapchain_data.depth_image.image_format;
+        inheritance_rendering_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        VkCommandBufferInheritanceInfo inheritance_info = {};
+        inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance_info.pNext = &inheritance_rendering_info;
+
+        auto record_range = [&](uint32_t range)
+        {
+            const size_t first = items.size() * range / range_count;
+            const size_t last = items.size() * (range + 1) / range_count;
+            VK_CHECK(vkResetCommandPool(m_device, frame.recording_command_pools[range], 0));
+            VkCommandBuffer secondary = frame.recording_command_buffers[range];
+            VkCommandBufferBeginInfo begin_info = init::command_buffer_begin_info(
+                VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+            begin_info.pInheritanceInfo = &inheritance_info;
+            VK_CHECK(vkBeginCommandBuffer(secondary, &begin_info));
+            record_direct_draws(secondary, items.subspan(first, last - first), static_cast<uint32_t>(first));
+            VK_CHECK(vkEndCommandBuffer(secondary));
+        };
+
+        // The render thread records the first range instead of idling on the others
+        std::vector<std::future<void>> jobs;
+        jobs.reserve(range_count - 1);
+        for (uint32_t range = 1; range < range_count; range++)
+        {
+            jobs.push_back(m_thread_pool.submit([&record_range, range]() { record_range(range); }));
+        }
+        record_range(0);
+        for (std::future<void>& job : jobs)
+        {
+            job.get();
+        }
+
+        render_info.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+        vkCmdBeginRendering(cmd, &render_info);
+        vkCmdExecuteCommands(cmd, range_count, frame.recording_command_buffers.data());
+        vkCmdEndRendering(cmd);
+    }
+
+    m_last_recording_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recording_start).count();
+    m_average_recording_ms = m_average_recording_ms == 0.0
+                                 ? m_last_recording_ms
+                                 : std::lerp(m_average_recording_ms, m_last_recording_ms, 0.05);
+}
+
+void Renderer::record_direct_draws(VkCommandBuffer cmd, std::span<const GPUDrawItem> items, uint32_t first_item)
+{
+    const GPUDrawList& draw_list = *m_culled_geometry.draw_list;
+    bind_geometry_state(cmd, draw_list.item_instance_buffer_address);
+    // firstInstance is the item index, which the item instance buffer maps to the instance like the visible list
+    for (uint32_t i = 0; i < items.size(); i++)
+    {
+        const GPUMeshLod& lod = items[i].lods[0];
+        vkCmdDrawIndexed(cmd, lod.index_count, 1, lod.first_index, items[i].vertex_offset, first_item + i);
+    }
+}
+
+glm::mat4 Renderer::get_projection() const
+{
+    glm::mat4 projection =
+        glm::perspective(glm::radians(70.f),
+                         // The output's aspect, the scaled draw extent is rounded to whole tiles
+                         (float)m_swapchain_data.swapchain_extent_2D.width /
+                             (float)m_swapchain_data.swapchain_extent_2D.height,
+                         10000.f,
+                         0.1f);
+
+    // invert the Y direction on projection matrix so that we are more similar
+    // to opengl and gltf axis
+    projection[1][1] *= -1;
+    return projection;
+}
+
+glm::mat4 Renderer::get_view() const
+{
+    return glm::translate(glm::vec3{ 0, 0, -5 });
+}
+
+glm::mat4 Renderer::get_view_projection() const
+{
+    return get_projection() * get_view();
 }
 
 void Renderer::draw_background(VkCommandBuffer cmd_buffer)
 {
+    if (m_compute_pipeline == VK_NULL_HANDLE)
+    {
+        // The background fills the whole draw image every frame, so block on it rather than skip it
+        m_compute_pipeline = m_compute_pipeline_job.get();
+    }
+    if (m_compute_pipeline == VK_NULL_HANDLE)
+    {
+        return;
+    }
     vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_compute_pipeline);
-    vkCmdBindDescriptorSets(
-        cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_compute_layout, 0, 1, &m_compute_descriptor_set, 0, nullptr);
+    m_bindless_table.bind(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_compute_layout);
     m_compute_push_constants.time.x = static_cast<float>(SDL_GetTicks()) / 1000.0f;
     m_compute_push_constants.cell_coords.x = glm::floor(m_mouse_pos.x / 16.0);
     m_compute_push_constants.cell_coords.y = glm::floor(m_mouse_pos.y / 16.0);
@@ -818,82 +1790,365 @@ void Renderer::draw_background(VkCommandBuffer cmd_buffer)
                   1);
 }
 
-void Renderer::draw_frame()
+bool Renderer::use_async_compute() const
 {
-    VK_CHECK(vkWaitForFences(m_device, 1, &get_current_frame().render_fence, true, 1'000'000'000));
-    get_current_frame().flush_frame_data();
+    return m_enable_async_compute && m_compute_queue != VK_NULL_HANDLE;
+}
+
+void Renderer::submit_async_background(uint32_t frame_slot)
+{
+    VkCommandBuffer cmd = get_current_frame().compute_command_buffer;
+    VK_CHECK(vkResetCommandBuffer(cmd, 0));
+    VkCommandBufferBeginInfo begin_info = init::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+    m_compute_profiler.begin_frame(cmd, frame_slot);
+
+    // The whole image is rewritten, and the graphics timeline wait already covers last frame's reads
+    VkImageMemoryBarrier2 image_barrier = {};
+    image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    image_barrier.pNext = nullptr;
+    image_barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    image_barrier.srcAccessMask = VK_ACCESS_2_NONE;
+    image_barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    image_barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    image_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    image_barrier.subresourceRange = init::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    image_barrier.image = m_swapchain_data.draw_image.image;
+
+    VkDependencyInfo dependency_info = {};
+    dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.pNext = nullptr;
+    dependency_info.imageMemoryBarrierCount = 1;
+    dependency_info.pImageMemoryBarriers = &image_barrier;
+    vkCmdPipelineBarrier2(cmd, &dependency_info);
 
-    uint32_t swapchain_image_index;
-    VkResult result = vkAcquireNextImageKHR(m_device,
-                                            m_swapchain_data.swapchain,
-                                            1'000'000'000,
-                                            get_current_frame().acquire_semaphore,
-                                            nullptr,
-                                            &swapchain_image_index);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
     {
-        m_swapchain_data.resize_requested = true;
+        GpuProfileScope scope(m_compute_profiler, cmd, "Background");
+        draw_background(cmd);
+    }
+    VK_CHECK(vkEndCommandBuffer(cmd));
+
+    const uint64_t graphics_value = m_timeline.get_submitted_value();
+    VkSemaphoreSubmitInfo wait_info = m_timeline.signal_info(graphics_value, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+    VkSemaphoreSubmitInfo signal_info =
+        init::semaphore_submit_info(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, m_async_compute_semaphore);
+    signal_info.value = ++m_async_compute_value;
+
+    VkCommandBufferSubmitInfo cmd_buffer_info = init::command_buffer_submit_info(cmd);
+    VkSubmitInfo2 submit =
+        init::submit_info(&cmd_buffer_info, &signal_info, graphics_value > 0 ? &wait_info : nullptr);
+    VK_CHECK(vkQueueSubmit2(m_compute_queue, 1, &submit, VK_NULL_HANDLE));
+}
+
+void Renderer::build_frame_graph(uint32_t frame_slot, uint32_t swapchain_image_index)
+{
+    constexpr VkPipelineStageFlags2 DEPTH_STAGES =
+        VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+    constexpr VkAccessFlags2 DEPTH_ACCESS =
+        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    constexpr VkAccessFlags2 COLOR_ACCESS =
+        VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+    constexpr VkAccessFlags2 STORAGE_ACCESS =
+        VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+    RenderGraph& graph = m_render_graph;
+    const RGHandle draw_image = graph.import_image(m_swapchain_data.draw_image.image, VK_IMAGE_ASPECT_COLOR_BIT);
+    const RGHandle depth_image = graph.import_image(m_swapchain_data.depth_image.image, VK_IMAGE_ASPECT_DEPTH_BIT);
+    if (m_transient_allocator.aliases(m_draw_image_target, m_depth_image_target))
+    {
+        graph.alias(draw_image, depth_image);
+    }
+
+    if (use_async_compute())
+    {
+        // Already written on the compute queue; the submit waits for it at color attachment output
+        graph.set_initial_state(
+            draw_image, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_IMAGE_LAYOUT_GENERAL);
+    }
+    else
+    {
+        // The background covers the whole draw image, so whatever the last frame left there is discarded
+        graph.add_pass("Background", [this](VkCommandBuffer cmd) { draw_background(cmd); })
+            .write(draw_image,
+                   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                   VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                   VK_IMAGE_LAYOUT_GENERAL,
+                   true);
+    }
+
+    const bool culled = select_culled_geometry();
+    const bool occlusion = culled && m_culled_geometry.occlusion;
+    const bool meshlets = culled && m_culled_geometry.meshlets;
+    RGHandle cull_output = 0;
+    RGHandle depth_pyramid = 0;
+    RGHandle meshlet_indices = 0;
+    // Expands the phase's surviving draws into meshlets and rewrites their commands to point into the index stream
+    auto add_meshlet_pass = [&](const char* name, GPUCullPhase phase)
+    {
+        graph.add_pass(name, [this, phase](VkCommandBuffer cmd) { cull_meshlets(cmd, phase); })
+            .write(cull_output, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, STORAGE_ACCESS)
+            .read(cull_output, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT)
+            .write(meshlet_indices, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    };
+    if (culled)
+    {
+        cull_output = graph.import_buffer(m_culled_geometry.draw_list->output_buffer.buffer);
+        depth_pyramid = graph.import_image(m_depth_pyramid.get_image(), VK_IMAGE_ASPECT_COLOR_BIT);
+        // Next frame's early phase tests against it
+        graph.mark_output(depth_pyramid);
+
+        graph
+            .add_pass("Cull Reset",
+                      [this](VkCommandBuffer cmd)
+                      {
+                          vkCmdFillBuffer(
+                              cmd, m_culled_geometry.draw_list->output_buffer.buffer, 0, sizeof(GPUCullStats), 0);
+                      })
+            .write(cull_output, VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+        graph.add_pass("Cull", [this](VkCommandBuffer cmd) { cull_geometry(cmd, CULL_PHASE_EARLY); })
+            .write(cull_output, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, STORAGE_ACCESS)
+            .read(depth_pyramid,
+                  VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                  VK_IMAGE_LAYOUT_GENERAL);
+        if (meshlets)
+        {
+            meshlet_indices = graph.import_buffer(m_culled_geometry.draw_list->meshlet_index_buffer.buffer);
+            add_meshlet_pass("Cull Meshlets", CULL_PHASE_EARLY);
+        }
+    }
+
+    auto add_geometry_pass = [&](const char* name, GPUCullPhase phase)
+    {
+        // The early pass clears depth, the late one draws on top of it
+        RenderGraph::PassBuilder pass =
+            graph.add_pass(name, [this, phase](VkCommandBuffer cmd) { draw_triangle(cmd, phase); })
+                .write(draw_image,
+                       VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                       COLOR_ACCESS,
+                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
+                .write(depth_image,
+                       DEPTH_STAGES,
+                       DEPTH_ACCESS,
+                       VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+                       phase == CULL_PHASE_EARLY);
+        if (culled)
+        {
+            pass.read(cull_output, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT)
+                .read(cull_output, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+        }
+        if (meshlets)
+        {
+            pass.read(meshlet_indices, VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT);
+        }
+    };
+    add_geometry_pass("Geometry", CULL_PHASE_EARLY);
+
+    if (occlusion)
+    {
+        // Pyramid of the early depth, for the late phase now and the early phase next frame
+        graph
+            .add_pass("Depth Pyramid",
+                      [this](VkCommandBuffer cmd)
+                      { m_depth_pyramid.build(cmd, get_current_frame().descriptor_allocator); })
+            .read(depth_image,
+                  VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                  VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL)
+            .write(depth_pyramid,
+                   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                   VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                   VK_IMAGE_LAYOUT_GENERAL,
+                   true);
+        graph.add_pass("Cull Late", [this](VkCommandBuffer cmd) { cull_geometry(cmd, CULL_PHASE_LATE); })
+            .write(cull_output, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, STORAGE_ACCESS)
+            .read(depth_pyramid,
+                  VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                  VK_IMAGE_LAYOUT_GENERAL);
+        if (meshlets)
+        {
+            add_meshlet_pass("Cull Meshlets Late", CULL_PHASE_LATE);
+        }
+        add_geometry_pass("Geometry Late", CULL_PHASE_LATE);
+    }
+
+    if (culled)
+    {
+        const RGHandle readback = graph.import_buffer(m_cull_stats_readback.buffer);
+        graph.add_pass("Cull Stats", [this, frame_slot](VkCommandBuffer cmd) { copy_cull_stats(cmd, frame_slot); })
+            .read(cull_output, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT)
+            .write(readback, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT)
+            .side_effect();
+    }
+
+    if (m_settings.headless)
+    {
+        graph.mark_output(draw_image);
+        return;
+    }
+
+    const VkImage swapchain_image = m_swapchain_data.swapchain_images[swapchain_image_index];
+    const VkImageView swapchain_image_view = m_swapchain_data.swapchain_image_views[swapchain_image_index];
+    const RGHandle swapchain = graph.import_image(swapchain_image, VK_IMAGE_ASPECT_COLOR_BIT);
+    // Matches the acquire semaphore's wait stage so the first barrier chains onto it
+    graph.set_initial_state(swapchain, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+    graph.set_final_layout(swapchain, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+    graph
+        .add_pass("Blit",
+                  [this, swapchain_image](VkCommandBuffer cmd)
+                  {
+                      util::copy_image_to_image(cmd,
+                                                m_swapchain_data.draw_image.image,
+                                                swapchain_image,
+                                                m_swapchain_data.draw_extent_2D,
+                                                m_swapchain_data.swapchain_extent_2D);
+                  })
+        .read(draw_image,
+              VK_PIPELINE_STAGE_2_BLIT_BIT,
+              VK_ACCESS_2_TRANSFER_READ_BIT,
+              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+        .write(swapchain,
+               VK_PIPELINE_STAGE_2_BLIT_BIT,
+               VK_ACCESS_2_TRANSFER_WRITE_BIT,
+               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+               true);
+    graph
+        .add_pass("ImGui",
+                  [this, swapchain_image_view](VkCommandBuffer cmd) { draw_imgui(cmd, swapchain_image_view); })
+        .write(swapchain,
+               VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+               COLOR_ACCESS,
+               VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+}
+
+void Renderer::wait_for_frame(FrameData& frame)
+{
+    VK_CHECK(m_timeline.wait(frame.timeline_value, 1'000'000'000));
+    if (frame.input_time == std::chrono::steady_clock::time_point{})
+    {
         return;
     }
+    m_last_input_latency_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame.input_time).count();
+    m_average_input_latency_ms = m_average_input_latency_ms == 0.0
+                                     ? m_last_input_latency_ms
+                                     : std::lerp(m_average_input_latency_ms, m_last_input_latency_ms, 0.05);
+    frame.input_time = {};
+}
 
-    VK_CHECK(vkResetFences(m_device, 1, &get_current_frame().render_fence));
+void Renderer::draw_frame()
+{
+    if (m_render_targets_dirty)
+    {
+        recreate_render_targets();
+    }
+    // The slot's previous submit must be done before its command buffer and per-slot readbacks are reused
+    wait_for_frame(get_current_frame());
+    m_timeline_deletion_queue.flush(m_timeline.get_completed_value());
+    get_current_frame().descriptor_allocator.reset();
+    const uint32_t frame_slot = m_frame_index % m_frames_in_flight;
+    m_gpu_frame_collected = collect_gpu_timings(frame_slot);
+    if (m_gpu_frame_collected && m_settings.dynamic_resolution)
+    {
+        m_dynamic_resolution.update(m_last_gpu_frame_ms);
+    }
+    update_draw_extent();
+    collect_cull_stats(frame_slot);
+    m_staging_ring.begin_frame(frame_slot, m_uploader.get_completed_value());
+
+    uint32_t swapchain_image_index = 0;
+    if (!m_settings.headless)
+    {
+        VkResult result = vkAcquireNextImageKHR(m_device,
+                                                m_swapchain_data.swapchain,
+                                                1'000'000'000,
+                                                get_current_frame().acquire_semaphore,
+                                                nullptr,
+                                                &swapchain_image_index);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+        {
+            m_swapchain_data.resize_requested = true;
+            return;
+        }
+    }
+
+    const bool async_background = use_async_compute();
+    if (async_background)
+    {
+        submit_async_background(frame_slot);
+    }
 
     VkCommandBuffer cmd_buffer = get_current_frame().command_buffer;
     VK_CHECK(vkResetCommandBuffer(cmd_buffer, 0));
     VkCommandBufferBeginInfo begin_info = init::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
     VK_CHECK(vkBeginCommandBuffer(cmd_buffer, &begin_info));
 
-    // Draw Compute
-    // TODO: Pass a bool to the draw_xxx funcs to toggle on and off. Make it configurable in ImGui
-    util::transition_image(
-        cmd_buffer, m_swapchain_data.draw_image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-    draw_background(cmd_buffer);
-
-    // Draw Rectangle
-    util::transition_image(cmd_buffer,
-                           m_swapchain_data.draw_image.image,
-                           VK_IMAGE_LAYOUT_GENERAL,
-                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-    util::transition_image(cmd_buffer,
-                           m_swapchain_data.depth_image.image,
-                           VK_IMAGE_LAYOUT_UNDEFINED,
-                           VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
-    draw_triangle(cmd_buffer);
-
-    // Draw ImGui
-    util::transition_image(cmd_buffer,
-                           m_swapchain_data.draw_image.image,
-                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-    util::transition_image(cmd_buffer,
-                           m_swapchain_data.swapchain_images[swapchain_image_index],
-                           VK_IMAGE_LAYOUT_UNDEFINED,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    util::copy_image_to_image(cmd_buffer,
-                              m_swapchain_data.draw_image.image,
-                              m_swapchain_data.swapchain_images[swapchain_image_index],
-                              m_swapchain_data.draw_extent_2D,
-                              m_swapchain_data.swapchain_extent_2D);
-    util::transition_image(cmd_buffer,
-                           m_swapchain_data.swapchain_images[swapchain_image_index],
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-    draw_imgui(cmd_buffer, m_swapchain_data.swapchain_image_views[swapchain_image_index]);
-    util::transition_image(cmd_buffer,
-                           m_swapchain_data.swapchain_images[swapchain_image_index],
-                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                           VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    m_gpu_profiler.begin_frame(cmd_buffer, frame_slot);
+    const uint32_t frame_scope = m_gpu_profiler.begin_scope(cmd_buffer, "Frame");
+
+    build_frame_graph(frame_slot, swapchain_image_index);
+    m_render_graph.execute(cmd_buffer, &m_gpu_profiler);
+    update_render_target_lifetimes();
+
+    m_gpu_profiler.end_scope(cmd_buffer, frame_scope);
 
     VK_CHECK(vkEndCommandBuffer(cmd_buffer));
 
+    std::array<VkSemaphoreSubmitInfo, 3> wait_infos = {};
+    uint32_t wait_count = 0;
+    if (async_background)
+    {
+        wait_infos[wait_count] = init::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                                             m_async_compute_semaphore);
+        wait_infos[wait_count++].value = m_async_compute_value;
+    }
+    if (!m_settings.headless)
+    {
+        wait_infos[wait_count++] = init::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+                                                               get_current_frame().acquire_semaphore);
+    }
+    if (m_frame_upload_wait_value > 0)
+    {
+        wait_infos[wait_count] = init::semaphore_submit_info(
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT |
+                VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+            m_uploader.get_timeline_semaphore());
+        wait_infos[wait_count++].value = m_frame_upload_wait_value;
+        m_frame_upload_wait_value = 0;
+    }
+
     VkCommandBufferSubmitInfo cmd_buffer_info = init::command_buffer_submit_info(cmd_buffer);
-    VkSemaphoreSubmitInfo wait_info = init::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
-                                                                  get_current_frame().acquire_semaphore);
-    VkSemaphoreSubmitInfo signal_info =
-        init::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, m_submit_semaphores[swapchain_image_index]);
-    VkSubmitInfo2 submit = init::submit_info(&cmd_buffer_info, &signal_info, &wait_info);
-    VK_CHECK(vkQueueSubmit2(
-        m_device.get_queue(vkb::QueueType::graphics).value(), 1, &submit, get_current_frame().render_fence));
+    // Slot 0 is the device timeline value, handed out under the queue lock. It paces this frame slot and releases
+    // deferred deletions, and the next async dispatch waits for it since the blit is the last read of the draw image.
+    std::array<VkSemaphoreSubmitInfo, 2> signal_infos = {};
+    uint32_t signal_count = 1;
+    if (!m_settings.headless)
+    {
+        signal_infos[signal_count++] = init::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
+                                                                   m_submit_semaphores[swapchain_image_index]);
+    }
+    VkSubmitInfo2 submit = init::submit_info(&cmd_buffer_info, nullptr, nullptr);
+    submit.waitSemaphoreInfoCount = wait_count;
+    submit.pWaitSemaphoreInfos = wait_infos.data();
+    submit.signalSemaphoreInfoCount = signal_count;
+    submit.pSignalSemaphoreInfos = signal_infos.data();
+
+    std::lock_guard queue_lock(m_graphics_queue_mutex);
+    const uint64_t frame_value = m_timeline.next_value();
+    signal_infos[0] = m_timeline.signal_info(frame_value, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+    VK_CHECK(vkQueueSubmit2(m_device.get_queue(vkb::QueueType::graphics).value(), 1, &submit, VK_NULL_HANDLE));
+    get_current_frame().timeline_value = frame_value;
+    get_current_frame().input_time = m_input_sample_time;
+    m_timeline_deletion_queue.stamp(frame_value);
+
+    if (m_settings.headless)
+    {
+        m_frame_index++;
+        return;
+    }
 
     VkPresentInfoKHR present_info = {};
     present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -904,7 +2159,7 @@ void Renderer::draw_frame()
     present_info.waitSemaphoreCount = 1;
     present_info.pImageIndices = &swapchain_image_index;
 
-    result = vkQueuePresentKHR(m_device.get_queue(vkb::QueueType::graphics).value(), &present_info);
+    VkResult result = vkQueuePresentKHR(m_device.get_queue(vkb::QueueType::graphics).value(), &present_info);
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
     {
         m_swapchain_data.resize_requested = true;
@@ -913,16 +2168,40 @@ void Renderer::draw_frame()
     m_frame_index++;
 }
 
-GPUMeshBuffers Renderer::gpu_mesh_upload(std::span<uint32_t> indices,
-                                         std::span<Vertex> vertices,
-                                         std::span<glm::mat4> instance_transforms)
+GPUMeshBuffers Renderer::gpu_mesh_upload(std::span<const uint32_t> indices,
+                                         std::span<const Vertex> vertices,
+                                         std::span<const GPUInstanceTransform> instance_transforms,
+                                         std::span<const uint32_t> vertex_meshes,
+                                         std::span<const uint32_t> instance_meshes,
+                                         uint32_t mesh_count,
+                                         std::span<const GPUMeshlet> meshlets)
 {
-    // Todo: Put this on a background thread?
-    const size_t vertex_buffer_size = vertices.size() * sizeof(Vertex);
-    const size_t index_buffer_size = indices.size() * sizeof(uint32_t);
-    const size_t instance_transform_buffer_size = instance_transforms.size() * sizeof(glm::mat4);
+    std::vector<QuantizedVertex> quantized_vertices;
+    std::vector<MeshQuantization> mesh_quantization;
+    if (m_settings.quantized_vertices)
+    {
+        mesh_quantization = vertex_quantization::compute_mesh_quantization(vertices, vertex_meshes, mesh_count);
+        quantized_vertices.resize(vertices.size());
+        vertex_quantization::encode(vertices, vertex_meshes, mesh_quantization, quantized_vertices);
+    }
+    const void* vertex_data =
+        m_settings.quantized_vertices ? static_cast<const void*>(quantized_vertices.data()) : vertices.data();
+    const size_t vertex_buffer_size =
+        m_settings.quantized_vertices ? std::span(quantized_vertices).size_bytes() : vertices.size_bytes();
+    // One index type covers every draw in the buffer, so 16-bit indices are only used when all of them fit. The
+    // meshlet pass copies indices as 32-bit words.
+    std::vector<uint16_t> short_indices;
+    const bool use_short_indices =
+        meshlets.empty() && std::ranges::all_of(indices, [](uint32_t index) { return index <= UINT16_MAX; });
+    if (use_short_indices)
+    {
+        short_indices.assign(indices.begin(), indices.end());
+    }
+    const void* index_data = use_short_indices ? static_cast<const void*>(short_indices.data()) : indices.data();
+    const size_t index_buffer_size = indices.size() * (use_short_indices ? sizeof(uint16_t) : sizeof(uint32_t));
+    const size_t instance_transform_buffer_size = instance_transforms.size_bytes();
 
-    GPUMeshBuffers new_surface;
+    GPUMeshBuffers new_surface = {};
     new_surface.vertex_buffer = create_buffer(vertex_buffer_size,
                                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
                                                   VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
@@ -932,8 +2211,15 @@ GPUMeshBuffers Renderer::gpu_mesh_upload(std::span<uint32_t> indices,
                                                             .buffer = new_surface.vertex_buffer.buffer };
     new_surface.vertex_buffer_address = vkGetBufferDeviceAddress(m_device, &vertex_device_adress_info);
 
-    new_surface.index_buffer = create_buffer(
-        index_buffer_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_AUTO);
+    VkBufferUsageFlags index_usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if (!meshlets.empty())
+    {
+        index_usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    }
+    new_surface.index_buffer = create_buffer(index_buffer_size, index_usage, VMA_MEMORY_USAGE_AUTO);
+    new_surface.index_type = use_short_indices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    new_surface.index_count = static_cast<uint32_t>(indices.size());
+    new_surface.index_buffer_bytes = index_buffer_size;
 
     new_surface.instance_transform_buffer =
         create_buffer(instance_transform_buffer_size,
@@ -943,62 +2229,139 @@ GPUMeshBuffers Renderer::gpu_mesh_upload(std::span<uint32_t> indices,
     VkBufferDeviceAddressInfo transform_device_adress_info = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
                                                                .buffer = new_surface.instance_transform_buffer.buffer };
     new_surface.instance_transform_buffer_address = vkGetBufferDeviceAddress(m_device, &transform_device_adress_info);
+    new_surface.instance_count = static_cast<uint32_t>(instance_transforms.size());
+    new_surface.vertex_bytes = vertex_buffer_size;
 
-    AllocatedBuffer staging = create_buffer(vertex_buffer_size + index_buffer_size + instance_transform_buffer_size,
-                                            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                            VMA_MEMORY_USAGE_AUTO);
-    void* data = staging.info.pMappedData; // had to change this from vkguides
-                                           // staging.alloction.GetMappedData()
-    memcpy(data, vertices.data(), vertex_buffer_size);
-    memcpy((char*)data + vertex_buffer_size, indices.data(), index_buffer_size);
-    memcpy((char*)data + vertex_buffer_size + index_buffer_size,
-           instance_transforms.data(),
-           instance_transform_buffer_size);
-
-    immediate_submit(
-        [vertex_buffer_size, index_buffer_size, instance_transform_buffer_size, staging, new_surface](
-            VkCommandBuffer cmd)
-        {
-            VkBufferCopy vertex_copy = {};
-            vertex_copy.dstOffset = 0;
-            vertex_copy.srcOffset = 0;
-            vertex_copy.size = vertex_buffer_size;
-            vkCmdCopyBuffer(cmd, staging.buffer, new_surface.vertex_buffer.buffer, 1, &vertex_copy);
-
-            VkBufferCopy index_copy = {};
-            index_copy.dstOffset = 0;
-            index_copy.srcOffset = vertex_buffer_size;
-            index_copy.size = index_buffer_size;
-            vkCmdCopyBuffer(cmd, staging.buffer, new_surface.index_buffer.buffer, 1, &index_copy);
-
-            VkBufferCopy transform_copy = {};
-            transform_copy.dstOffset = 0;
-            transform_copy.srcOffset = vertex_buffer_size + index_buffer_size;
-            transform_copy.size = instance_transform_buffer_size;
-            vkCmdCopyBuffer(cmd, staging.buffer, new_surface.instance_transform_buffer.buffer, 1, &transform_copy);
-        });
+    auto create_storage_buffer = [this](size_t size, AllocatedBuffer& buffer, VkDeviceAddress& address)
+    {
+        buffer = create_buffer(size,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                   VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                               VMA_MEMORY_USAGE_AUTO);
+        VkBufferDeviceAddressInfo address_info = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+                                                   .buffer = buffer.buffer };
+        address = vkGetBufferDeviceAddress(m_device, &address_info);
+    };
+    if (m_settings.quantized_vertices)
+    {
+        create_storage_buffer(std::span(mesh_quantization).size_bytes(),
+                              new_surface.mesh_quantization_buffer,
+                              new_surface.mesh_quantization_buffer_address);
+        create_storage_buffer(
+            instance_meshes.size_bytes(), new_surface.instance_mesh_buffer, new_surface.instance_mesh_buffer_address);
+    }
+    if (!meshlets.empty())
+    {
+        create_storage_buffer(meshlets.size_bytes(), new_surface.meshlet_buffer, new_surface.meshlet_buffer_address);
+        VkBufferDeviceAddressInfo index_address_info = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+                                                         .buffer = new_surface.index_buffer.buffer };
+        new_surface.index_buffer_address = vkGetBufferDeviceAddress(m_device, &index_address_info);
+        new_surface.meshlet_count = static_cast<uint32_t>(meshlets.size());
+    }
 
-    destroy_buffer(staging);
+    // Copies run on the transfer queue in the background. Frames join through upload_ready_for_frame.
+    UploadBatch batch = m_uploader.begin_batch();
+    batch.copy_to_buffer(new_surface.vertex_buffer.buffer, 0, vertex_data, vertex_buffer_size);
+    batch.copy_to_buffer(new_surface.index_buffer.buffer, 0, index_data, index_buffer_size);
+    batch.copy_to_buffer(
+        new_surface.instance_transform_buffer.buffer, 0, instance_transforms.data(), instance_transform_buffer_size);
+    if (m_settings.quantized_vertices)
+    {
+        batch.copy_to_buffer(new_surface.mesh_quantization_buffer.buffer,
+                             0,
+                             mesh_quantization.data(),
+                             std::span(mesh_quantization).size_bytes());
+        batch.copy_to_buffer(
+            new_surface.instance_mesh_buffer.buffer, 0, instance_meshes.data(), instance_meshes.size_bytes());
+    }
+    if (!meshlets.empty())
+    {
+        batch.copy_to_buffer(new_surface.meshlet_buffer.buffer, 0, meshlets.data(), meshlets.size_bytes());
+    }
+    new_surface.upload = m_uploader.submit(std::move(batch));
     return new_surface;
 }
 
-void Renderer::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function)
+bool Renderer::upload_ready_for_frame(const UploadTicket& upload)
 {
-    // Todo: Switch the queue to use another queue rather than graphics
-    VK_CHECK(vkResetFences(m_device, 1, &m_imm_fence));
-    VK_CHECK(vkResetCommandBuffer(m_imm_command_buffer, 0));
+    if (!m_uploader.is_submitted(upload.value))
+    {
+        return false;
+    }
+    if (!m_uploader.is_complete(upload.value))
+    {
+        // Still copying, the frame's submit waits for it on the GPU instead of the CPU
+        m_frame_upload_wait_value = std::max(m_frame_upload_wait_value, upload.value);
+    }
+    return true;
+}
+
+GPUDrawList Renderer::create_draw_list(std::span<const GPUDrawItem> draw_items, uint32_t meshlet_index_capacity)
+{
+    GPUDrawList draw_list;
+    draw_list.draw_count = static_cast<uint32_t>(draw_items.size());
+    draw_list.draw_buffer = create_buffer(draw_items.size_bytes(),
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                              VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                          VMA_MEMORY_USAGE_AUTO);
+    VkBufferDeviceAddressInfo draw_device_adress_info = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+                                                          .buffer = draw_list.draw_buffer.buffer };
+    draw_list.draw_buffer_address = vkGetBufferDeviceAddress(m_device, &draw_device_adress_info);
+
+    // Counts, indirect commands and the per-command arrays, sized for the case where nothing is culled
+    draw_list.output_buffer = create_buffer(draw_list.get_output_size(),
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                                VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                            VMA_MEMORY_USAGE_AUTO);
+    VkBufferDeviceAddressInfo output_device_adress_info = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+                                                            .buffer = draw_list.output_buffer.buffer };
+    draw_list.output_buffer_address = vkGetBufferDeviceAddress(m_device, &output_device_adress_info);
+
+    if (meshlet_index_capacity > 0)
+    {
+        draw_list.meshlet_index_capacity = meshlet_index_capacity;
+        draw_list.meshlet_index_buffer = create_buffer(static_cast<size_t>(meshlet_index_capacity) * sizeof(uint32_t),
+                                                       VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                                       VMA_MEMORY_USAGE_AUTO);
+        VkBufferDeviceAddressInfo stream_address_info = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+                                                          .buffer = draw_list.meshlet_index_buffer.buffer };
+        draw_list.meshlet_index_buffer_address = vkGetBufferDeviceAddress(m_device, &stream_address_info);
+    }
 
-    VkCommandBuffer imm_cmd = m_imm_command_buffer;
-    VkCommandBufferBeginInfo cmdBeginInfo =
-        init::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-    VK_CHECK(vkBeginCommandBuffer(imm_cmd, &cmdBeginInfo));
-    function(imm_cmd);
-    VK_CHECK(vkEndCommandBuffer(imm_cmd));
+    // Direct draws read the instance through the item index they pass as firstInstance
+    draw_list.draw_items.assign(draw_items.begin(), draw_items.end());
+    std::vector<uint32_t> item_instances;
+    item_instances.reserve(draw_items.size());
+    for (const GPUDrawItem& item : draw_items)
+    {
+        item_instances.push_back(item.instance);
+    }
+    draw_list.item_instance_buffer = create_buffer(std::span(item_instances).size_bytes(),
+                                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                       VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                                       VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                                   VMA_MEMORY_USAGE_AUTO);
+    VkBufferDeviceAddressInfo item_instance_address_info = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+                                                             .buffer = draw_list.item_instance_buffer.buffer };
+    draw_list.item_instance_buffer_address = vkGetBufferDeviceAddress(m_device, &item_instance_address_info);
+
+    UploadBatch batch = m_uploader.begin_batch();
+    batch.copy_to_buffer(draw_list.draw_buffer.buffer, 0, draw_items.data(), draw_items.size_bytes());
+    batch.copy_to_buffer(
+        draw_list.item_instance_buffer.buffer, 0, item_instances.data(), std::span(item_instances).size_bytes());
+    draw_list.upload = m_uploader.submit(std::move(batch));
+    return draw_list;
+}
 
-    VkCommandBufferSubmitInfo cmd_info = init::command_buffer_submit_info(imm_cmd);
-    VkSubmitInfo2 submit_info = init::submit_info(&cmd_info, nullptr, nullptr);
-    VK_CHECK(vkQueueSubmit2(m_device.get_queue(vkb::QueueType::graphics).value(), 1, &submit_info, m_imm_fence));
-    VK_CHECK(vkWaitForFences(m_device, 1, &m_imm_fence, true, 9999999999));
+void Renderer::destroy_draw_list(GPUDrawList& draw_list)
+{
+    destroy_buffer(draw_list.draw_buffer);
+    destroy_buffer(draw_list.output_buffer);
+    destroy_buffer(draw_list.meshlet_index_buffer);
+    destroy_buffer(draw_list.item_instance_buffer);
 }
 
 void Renderer::init_default_data()
@@ -1023,14 +2386,17 @@ void Renderer::init_default_data()
     rect_indices[4] = 1;
     rect_indices[5] = 3;
 
-    std::array<glm::mat4, 10> instance_transforms;
+    const uint32_t instance_count = std::max(1u, m_settings.rectangle_instance_count);
+    std::vector<glm::mat4> instance_transforms(instance_count);
 
     // From ChatGPT
     // Random number generator
     std::mt19937 rng{ std::random_device{}() };
 
-    // Example: random positions in range [-10, 10]
-    std::uniform_real_distribution<float> dist(-2.5f, 2.5f);
+    // Random positions in [-2.5, 2.5] for the default 10 instances, the volume grows with the instance count so
+    // large counts spill outside the frustum
+    const float extent = 2.5f * std::cbrt(instance_count / 10.0f);
+    std::uniform_real_distribution<float> dist(-extent, extent);
 
     for (glm::mat4& m : instance_transforms)
     {
@@ -1039,7 +2405,30 @@ void Renderer::init_default_data()
         m = glm::translate(glm::mat4(1.0f), pos);
     }
 
-    m_rectangle = gpu_mesh_upload(rect_indices, rect_vertices, instance_transforms);
+    std::vector<GPUInstanceTransform> packed_transforms(instance_count);
+    std::ranges::transform(instance_transforms, packed_transforms.begin(), GPUInstanceTransform::from_matrix);
+    // A single mesh: every vertex and instance maps to mesh 0
+    const std::array<uint32_t, 4> rect_vertex_meshes = {};
+    std::vector<uint32_t> rect_instance_meshes(m_settings.quantized_vertices ? instance_count : 0, 0);
+    m_rectangle = gpu_mesh_upload(
+        rect_indices, rect_vertices, packed_transforms, rect_vertex_meshes, rect_instance_meshes, 1);
+    m_rectangle_instance_transforms = std::move(instance_transforms);
+
+    std::vector<GPUDrawItem> rect_draw_items(instance_count);
+    for (uint32_t i = 0; i < instance_count; i++)
+    {
+        rect_draw_items[i] = { .bounds_sphere = glm::vec4(0.0f, 0.0f, 0.0f, glm::sqrt(0.5f)),
+                               .vertex_offset = 0,
+                               .instance = i,
+                               .lod_count = 1,
+                               .lods = { { .first_index = 0, .index_count = 6 } } };
+    }
+    m_rectangle_draw_list = create_draw_list(rect_draw_items);
+
+    if (!m_settings.scene_path.empty())
+    {
+        load_scene(m_settings.scene_path);
+    }
 
     m_deletion_queue.push_function(
         [this]()
@@ -1047,6 +2436,9 @@ void Renderer::init_default_data()
             destroy_buffer(m_rectangle.index_buffer);
             destroy_buffer(m_rectangle.vertex_buffer);
             destroy_buffer(m_rectangle.instance_transform_buffer);
+            destroy_buffer(m_rectangle.mesh_quantization_buffer);
+            destroy_buffer(m_rectangle.instance_mesh_buffer);
+            destroy_draw_list(m_rectangle_draw_list);
         });
 
     // Compute Push Constants
@@ -1056,6 +2448,124 @@ void Renderer::init_default_data()
     m_compute_push_constants.cell_coords = glm::vec4(0.0f);
 }
 
+void Renderer::load_scene(const std::filesystem::path& file_path)
+{
+    const auto load_start = std::chrono::steady_clock::now();
+    const bool is_cooked = file_path.extension() == ".bkmesh";
+    const std::filesystem::path cooked_path = is_cooked ? file_path : mesh_cache::cooked_path_for(file_path);
+
+    // Warm path: the cooked file is mapped and its arrays go to the uploader as they are
+    CookedScene cooked;
+    if (cooked.open(cooked_path) && (is_cooked || mesh_cache::is_up_to_date(cooked, file_path)))
+    {
+        std::println("Mapped cooked scene {} in {:.3f} ms",
+                     cooked_path.string(),
+                     std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count());
+        // Staging copies happen during submit, so the mapping can be released right after
+        upload_scene(cooked.view());
+        return;
+    }
+    cooked.close();
+    if (is_cooked)
+    {
+        std::cerr << "Cooked scene " << file_path << " is invalid" << std::endl;
+        return;
+    }
+
+    std::optional<SceneData> scene = loader::load_gltf(file_path, m_thread_pool);
+    if (!scene)
+    {
+        std::cerr << "No drawable geometry in " << file_path << std::endl;
+        return;
+    }
+    upload_scene(scene->view());
+    mesh_cache::write(*scene, file_path, cooked_path);
+}
+
+void Renderer::upload_scene(const SceneView& scene)
+{
+    if (scene.primitives.empty() || scene.instance_transforms.empty())
+    {
+        std::cerr << "Scene has no drawable geometry" << std::endl;
+        return;
+    }
+
+    // All primitives share one vertex and one index megabuffer
+    const auto upload_start = std::chrono::steady_clock::now();
+    // Primitives own their vertex range, so the indices tell which mesh each vertex belongs to
+    std::vector<uint32_t> vertex_meshes;
+    if (m_settings.quantized_vertices)
+    {
+        vertex_meshes.assign(scene.vertices.size(), UINT32_MAX);
+        for (uint32_t mesh_index = 0; mesh_index < scene.meshes.size(); mesh_index++)
+        {
+            const SceneMesh& mesh = scene.meshes[mesh_index];
+            for (const ScenePrimitive& primitive : scene.primitives.subspan(mesh.first_primitive, mesh.primitive_count))
+            {
+                // The coarser levels only use vertices of the full-detail one
+                const GPUMeshLod& full_detail = primitive.lods[0];
+                for (uint32_t index : scene.indices.subspan(full_detail.first_index, full_detail.index_count))
+                {
+                    vertex_meshes[primitive.vertex_offset + index] = mesh_index;
+                }
+            }
+        }
+    }
+    m_scene.buffers = gpu_mesh_upload(scene.indices,
+                                      scene.vertices,
+                                      scene.instance_transforms,
+                                      vertex_meshes,
+                                      scene.instance_meshes,
+                                      static_cast<uint32_t>(scene.meshes.size()),
+                                      m_settings.meshlet_culling ? scene.meshlets : std::span<const GPUMeshlet>());
+    m_scene.meshes.assign(scene.meshes.begin(), scene.meshes.end());
+    m_scene.primitives.assign(scene.primitives.begin(), scene.primitives.end());
+    m_scene.instance_meshes.assign(scene.instance_meshes.begin(), scene.instance_meshes.end());
+
+    // Every primitive of every instance becomes one draw item for the cull pass
+    std::vector<GPUDrawItem> draw_items;
+    uint64_t full_detail_index_count = 0;
+    for (uint32_t instance = 0; instance < scene.instance_meshes.size(); instance++)
+    {
+        const SceneMesh& mesh = scene.meshes[scene.instance_meshes[instance]];
+        for (uint32_t i = 0; i < mesh.primitive_count; i++)
+        {
+            const ScenePrimitive& primitive = scene.primitives[mesh.first_primitive + i];
+            GPUDrawItem& item = draw_items.emplace_back();
+            item.bounds_sphere = primitive.bounds_sphere;
+            item.vertex_offset = primitive.vertex_offset;
+            item.instance = instance;
+            item.lod_count = primitive.lod_count;
+            std::ranges::copy(primitive.lods, item.lods);
+            full_detail_index_count += primitive.lods[0].index_count;
+        }
+    }
+    // The stream holds every surviving meshlet, at most everything at full detail
+    const uint32_t meshlet_index_capacity =
+        m_scene.buffers.meshlet_count > 0
+            ? static_cast<uint32_t>(std::min<uint64_t>(full_detail_index_count, MAX_MESHLET_STREAM_INDICES))
+            : 0;
+    m_scene.draw_list = create_draw_list(draw_items, meshlet_index_capacity);
+    m_scene.loaded = true;
+    std::println("\tupload submit {:.3f} ms ({:.2f} MB, completes asynchronously)",
+                 std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - upload_start).count(),
+                 (m_scene.buffers.vertex_bytes + m_scene.buffers.index_buffer_bytes +
+                  scene.instance_transforms.size_bytes()) /
+                     (1024.0 * 1024.0));
+
+    m_deletion_queue.push_function(
+        [this]()
+        {
+            destroy_buffer(m_scene.buffers.index_buffer);
+            destroy_buffer(m_scene.buffers.vertex_buffer);
+            destroy_buffer(m_scene.buffers.instance_transform_buffer);
+            destroy_buffer(m_scene.buffers.mesh_quantization_buffer);
+            destroy_buffer(m_scene.buffers.instance_mesh_buffer);
+            destroy_buffer(m_scene.buffers.meshlet_buffer);
+            destroy_draw_list(m_scene.draw_list);
+        });
+}
+
 void DeletionQueue::push_function(std::function<void()>&& func)
 {
     deletion_queue.push_back(std::move(func));
@@ -1069,3 +2579,44 @@ void DeletionQueue::flush()
     }
     deletion_queue.clear();
 }
+
+void TimelineDeletionQueue::push_function(std::function<void()>&& func)
+{
+    deletion_queue.emplace_back(UNSTAMPED, std::move(func));
+}
+
+void TimelineDeletionQueue::stamp(uint64_t value)
+{
+    // Unstamped entries are always at the back, so the queue stays sorted by value
+    for (auto& entry : std::views::reverse(deletion_queue))
+    {
+        if (entry.first != UNSTAMPED)
+        {
+            break;
+        }
+        entry.first = value;
+    }
+}
+
+void TimelineDeletionQueue::flush(uint64_t completed_value)
+{
+    size_t count = 0;
+    while (count < deletion_queue.size() && deletion_queue[count].first <= completed_value)
+    {
+        count++;
+    }
+    for (size_t i = count; i > 0; i--)
+    {
+        deletion_queue[i - 1].second();
+    }
+    deletion_queue.erase(deletion_queue.begin(), deletion_queue.begin() + count);
+}
+
+void TimelineDeletionQueue::flush_all()
+{
+    for (auto& entry : std::views::reverse(deletion_queue))
+    {
+        entry.second();
+    }
+    deletion_queue.clear();
+}
@@ -0,0 +1,370 @@
+#include "SceneLoader.h"
+#include "MeshOptimizer.h"
+
+#include <fastgltf/core.hpp>
+#include <fastgltf/tools.hpp>
+#include <fastgltf/glm_element_traits.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <print>
+
+namespace loader
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Levels below this many indices save too little to be worth a draw of their own
+    static constexpr size_t MIN_LOD_INDEX_COUNT = 3 * 64;
+
+    static double elapsed_ms(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // Decodes one primitive into its pre-reserved slice of the shared arrays
+    static void decode_primitive(fastgltf::Asset& gltf,
+                                 fastgltf::Primitive& primitive,
+                                 ScenePrimitive& placement,
+                                 size_t vertex_count,
+                                 Vertex* vertices,
+                                 uint32_t* indices)
+    {
+        for (size_t i = 0; i < vertex_count; i++)
+        {
+            vertices[i].position = glm::vec3(0.0f);
+            vertices[i].normal = glm::vec3(1.0f, 0.0f, 0.0f);
+            vertices[i].uv_x = 0.0f;
+            vertices[i].uv_y = 0.0f;
+            vertices[i].color = glm::vec4(1.0f);
+        }
+
+        auto position = primitive.findAttribute("POSITION");
+        fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf,
+                                                      gltf.accessors[position->accessorIndex],
+                                                      [&](glm::vec3 v, size_t i) { vertices[i].position = v; });
+
+        glm::vec3 bounds_min(std::numeric_limits<float>::max());
+        glm::vec3 bounds_max(std::numeric_limits<float>::lowest());
+        for (size_t i = 0; i < vertex_count; i++)
+        {
+            bounds_min = glm::min(bounds_min, vertices[i].position);
+            bounds_max = glm::max(bounds_max, vertices[i].position);
+        }
+        placement.bounds_sphere = vertex_count > 0 ? glm::vec4((bounds_min + bounds_max) * 0.5f,
+                                                               glm::length(bounds_max - bounds_min) * 0.5f)
+                                                   : glm::vec4(0.0f);
+
+        auto normal = primitive.findAttribute("NORMAL");
+        if (normal != primitive.attributes.end())
+        {
+            fastgltf::iterateAccessorWithIndex<glm::vec3>(
+                gltf, gltf.accessors[normal->accessorIndex], [&](glm::vec3 n, size_t i) { vertices[i].normal = n; });
+        }
+
+        auto uv = primitive.findAttribute("TEXCOORD_0");
+        if (uv != primitive.attributes.end())
+        {
+            fastgltf::iterateAccessorWithIndex<glm::vec2>(gltf,
+                                                          gltf.accessors[uv->accessorIndex],
+                                                          [&](glm::vec2 t, size_t i)
+                                                          {
+                                                              vertices[i].uv_x = t.x;
+                                                              vertices[i].uv_y = t.y;
+                                                          });
+        }
+
+        auto color = primitive.findAttribute("COLOR_0");
+        if (color != primitive.attributes.end())
+        {
+            const fastgltf::Accessor& color_accessor = gltf.accessors[color->accessorIndex];
+            if (color_accessor.type == fastgltf::AccessorType::Vec3)
+            {
+                fastgltf::iterateAccessorWithIndex<glm::vec3>(
+                    gltf, color_accessor, [&](glm::vec3 c, size_t i) { vertices[i].color = glm::vec4(c, 1.0f); });
+            }
+            else
+            {
+                fastgltf::iterateAccessorWithIndex<glm::vec4>(
+                    gltf, color_accessor, [&](glm::vec4 c, size_t i) { vertices[i].color = c; });
+            }
+        }
+        else
+        {
+            // No vertex colors, visualize the normals instead
+            for (size_t i = 0; i < vertex_count; i++)
+            {
+                vertices[i].color = glm::vec4(vertices[i].normal * 0.5f + 0.5f, 1.0f);
+            }
+        }
+
+        if (primitive.indicesAccessor.has_value())
+        {
+            fastgltf::copyFromAccessor<std::uint32_t>(gltf, gltf.accessors[primitive.indicesAccessor.value()], indices);
+        }
+        else
+        {
+            std::iota(indices, indices + placement.lods[0].index_count, 0u);
+        }
+    }
+
+    // Simplifies each level to half the triangles of the one before. `lod_indices` receives the coarser levels back
+    // to back; their first_index is relative to its start until the caller places them in the shared array.
+    static void build_lods(std::span<const uint32_t> indices,
+                           std::span<const Vertex> vertices,
+                           ScenePrimitive& placement,
+                           std::vector<uint32_t>& lod_indices)
+    {
+        std::span<const uint32_t> previous = indices;
+        float error = 0.0f;
+        while (placement.lod_count < MAX_MESH_LODS)
+        {
+            const size_t target_index_count = previous.size() / 6 * 3;
+            if (target_index_count < MIN_LOD_INDEX_COUNT)
+            {
+                break;
+            }
+            float lod_error = 0.0f;
+            std::vector<uint32_t> simplified =
+                mesh_optimizer::simplify(previous, vertices, target_index_count, lod_error);
+            // Mostly locked by seams and borders; another level would cost memory without saving much
+            if (simplified.size() > previous.size() * 3 / 4)
+            {
+                break;
+            }
+            mesh_optimizer::optimize_vertex_cache(simplified, vertices.size());
+
+            // Each level is simplified from the previous one, so their errors add up
+            error += lod_error;
+            const size_t first_index = lod_indices.size();
+            lod_indices.insert(lod_indices.end(), simplified.begin(), simplified.end());
+            GPUMeshLod& lod = placement.lods[placement.lod_count++];
+            lod = {};
+            lod.first_index = static_cast<uint32_t>(first_index);
+            lod.index_count = static_cast<uint32_t>(simplified.size());
+            lod.error = error;
+            previous = std::span(lod_indices).subspan(first_index);
+        }
+    }
+
+    // Splits every level into meshlets. `first_meshlet` is relative to the start of `meshlets` until the caller places
+    // them in the shared array.
+    static void build_meshlets(std::span<const uint32_t> indices,
+                               std::span<const uint32_t> lod_indices,
+                               std::span<const Vertex> vertices,
+                               ScenePrimitive& placement,
+                               std::vector<GPUMeshlet>& meshlets)
+    {
+        for (uint32_t level = 0; level < placement.lod_count; level++)
+        {
+            GPUMeshLod& lod = placement.lods[level];
+            lod.first_meshlet = static_cast<uint32_t>(meshlets.size());
+            const std::span<const uint32_t> level_indices =
+                level == 0 ? indices : lod_indices.subspan(lod.first_index, lod.index_count);
+            mesh_optimizer::build_meshlets(level_indices, vertices, meshlets);
+            lod.meshlet_count = static_cast<uint32_t>(meshlets.size()) - lod.first_meshlet;
+        }
+    }
+
+    std::optional<SceneData> load_gltf(const std::filesystem::path& file_path, ThreadPool& thread_pool)
+    {
+        auto stage_start = Clock::now();
+#if FASTGLTF_HAS_MEMORY_MAPPED_FILE
+        auto data = fastgltf::MappedGltfFile::FromPath(file_path);
+#else
+        auto data = fastgltf::GltfDataBuffer::FromPath(file_path);
+#endif
+        if (data.error() != fastgltf::Error::None)
+        {
+            std::cerr << "Failed to open " << file_path << ": " << fastgltf::getErrorMessage(data.error())
+                      << std::endl;
+            return std::nullopt;
+        }
+        const double map_ms = elapsed_ms(stage_start);
+
+        stage_start = Clock::now();
+        fastgltf::Parser parser;
+        auto asset = parser.loadGltf(data.get(), file_path.parent_path(), fastgltf::Options::LoadExternalBuffers);
+        if (asset.error() != fastgltf::Error::None)
+        {
+            std::cerr << "Failed to parse " << file_path << ": " << fastgltf::getErrorMessage(asset.error())
+                      << std::endl;
+            return std::nullopt;
+        }
+        fastgltf::Asset& gltf = asset.get();
+        const double parse_ms = elapsed_ms(stage_start);
+
+        // Lay out every triangle primitive in the shared arrays up front, so decoding needs no synchronization
+        stage_start = Clock::now();
+        SceneData scene;
+        std::vector<fastgltf::Primitive*> sources;
+        std::vector<size_t> source_vertex_counts;
+        size_t total_vertices = 0;
+        size_t total_indices = 0;
+        for (fastgltf::Mesh& gltf_mesh : gltf.meshes)
+        {
+            SceneMesh& mesh = scene.meshes.emplace_back();
+            mesh.name = gltf_mesh.name;
+            mesh.first_primitive = static_cast<uint32_t>(scene.primitives.size());
+            for (fastgltf::Primitive& primitive : gltf_mesh.primitives)
+            {
+                auto position = primitive.findAttribute("POSITION");
+                if (position == primitive.attributes.end() || primitive.type != fastgltf::PrimitiveType::Triangles)
+                {
+                    continue;
+                }
+                const size_t vertex_count = gltf.accessors[position->accessorIndex].count;
+                const size_t index_count = primitive.indicesAccessor.has_value()
+                                               ? gltf.accessors[primitive.indicesAccessor.value()].count
+                                               : vertex_count;
+
+                ScenePrimitive& placement = scene.primitives.emplace_back();
+                placement.lod_count = 1;
+                placement.lods[0] = {};
+                placement.lods[0].first_index = static_cast<uint32_t>(total_indices);
+                placement.lods[0].index_count = static_cast<uint32_t>(index_count);
+                placement.vertex_offset = static_cast<int32_t>(total_vertices);
+                sources.push_back(&primitive);
+                source_vertex_counts.push_back(vertex_count);
+                total_vertices += vertex_count;
+                total_indices += index_count;
+            }
+            mesh.primitive_count = static_cast<uint32_t>(scene.primitives.size()) - mesh.first_primitive;
+        }
+        scene.vertices.resize(total_vertices);
+        scene.indices.resize(total_indices);
+
+        // Primitives are decoded, optimized and simplified on the pool; deduplication may shrink each vertex range
+        std::vector<mesh_optimizer::Stats> optimize_stats(sources.size());
+        std::vector<std::vector<uint32_t>> lod_indices(sources.size());
+        std::vector<std::vector<GPUMeshlet>> meshlets(sources.size());
+
+        // A few chunks per worker keeps the pool busy when primitive sizes are uneven
+        const size_t chunk_count = std::min<size_t>(sources.size(), thread_pool.get_thread_count() * 4);
+        std::vector<std::future<void>> jobs;
+        jobs.reserve(chunk_count);
+        for (size_t chunk = 0; chunk < chunk_count; chunk++)
+        {
+            const size_t begin = sources.size() * chunk / chunk_count;
+            const size_t end = sources.size() * (chunk + 1) / chunk_count;
+            jobs.push_back(thread_pool.submit(
+                [&, begin, end]()
+                {
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        ScenePrimitive& placement = scene.primitives[i];
+                        decode_primitive(gltf,
+                                         *sources[i],
+                                         placement,
+                                         source_vertex_counts[i],
+                                         scene.vertices.data() + placement.vertex_offset,
+                                         scene.indices.data() + placement.lods[0].first_index);
+                        const std::span<Vertex> vertices =
+                            std::span(scene.vertices).subspan(placement.vertex_offset, source_vertex_counts[i]);
+                        const std::span<uint32_t> indices = std::span(scene.indices)
+                                                                .subspan(placement.lods[0].first_index,
+                                                                         placement.lods[0].index_count);
+                        optimize_stats[i] = mesh_optimizer::optimize(vertices, indices);
+                        const std::span<const Vertex> optimized_vertices =
+                            vertices.first(optimize_stats[i].vertex_count_after);
+                        build_lods(indices, optimized_vertices, placement, lod_indices[i]);
+                        build_meshlets(indices, lod_indices[i], optimized_vertices, placement, meshlets[i]);
+                    }
+                }));
+        }
+        for (std::future<void>& job : jobs)
+        {
+            job.get();
+        }
+        const double decode_ms = elapsed_ms(stage_start);
+
+        // Close the gaps deduplication left between the vertex ranges
+        mesh_optimizer::Stats total_stats = {};
+        size_t compacted_vertices = 0;
+        for (size_t i = 0; i < scene.primitives.size(); i++)
+        {
+            ScenePrimitive& placement = scene.primitives[i];
+            const size_t vertex_count = optimize_stats[i].vertex_count_after;
+            std::copy_n(scene.vertices.begin() + placement.vertex_offset,
+                        vertex_count,
+                        scene.vertices.begin() + compacted_vertices);
+            placement.vertex_offset = static_cast<int32_t>(compacted_vertices);
+            compacted_vertices += vertex_count;
+            total_stats.add(optimize_stats[i]);
+        }
+        scene.vertices.resize(compacted_vertices);
+
+        // The coarser levels go after every full-detail range, the meshlets into one shared table
+        size_t lod_index_count = 0;
+        for (size_t i = 0; i < scene.primitives.size(); i++)
+        {
+            ScenePrimitive& placement = scene.primitives[i];
+            for (uint32_t lod = 0; lod < placement.lod_count; lod++)
+            {
+                placement.lods[lod].first_index += lod > 0 ? static_cast<uint32_t>(scene.indices.size()) : 0;
+                placement.lods[lod].first_meshlet += static_cast<uint32_t>(scene.meshlets.size());
+            }
+            scene.indices.insert(scene.indices.end(), lod_indices[i].begin(), lod_indices[i].end());
+            scene.meshlets.insert(scene.meshlets.end(), meshlets[i].begin(), meshlets[i].end());
+            lod_index_count += lod_indices[i].size();
+        }
+
+        stage_start = Clock::now();
+        auto add_instance = [&scene](uint32_t mesh_index, const glm::mat4& transform)
+        {
+            scene.instance_transforms.push_back(GPUInstanceTransform::from_matrix(transform));
+            scene.instance_meshes.push_back(mesh_index);
+        };
+        if (gltf.scenes.empty())
+        {
+            for (uint32_t mesh_index = 0; mesh_index < scene.meshes.size(); mesh_index++)
+            {
+                add_instance(mesh_index, glm::mat4(1.0f));
+            }
+        }
+        else
+        {
+            const size_t scene_index = gltf.defaultScene.value_or(0);
+            fastgltf::iterateSceneNodes(gltf,
+                                        scene_index,
+                                        fastgltf::math::fmat4x4(),
+                                        [&](fastgltf::Node& node, fastgltf::math::fmat4x4 matrix)
+                                        {
+                                            if (node.meshIndex.has_value())
+                                            {
+                                                add_instance(static_cast<uint32_t>(node.meshIndex.value()),
+                                                             glm::make_mat4(matrix.data()));
+                                            }
+                                        });
+        }
+        const double instance_ms = elapsed_ms(stage_start);
+
+        std::println("Loaded {}: {} meshes, {} primitives, {} instances, {} vertices, {} indices",
+                     file_path.string(),
+                     scene.meshes.size(),
+                     scene.primitives.size(),
+                     scene.instance_transforms.size(),
+                     scene.vertices.size(),
+                     scene.indices.size());
+        std::println("\tACMR {:.3f} -> {:.3f} (FIFO {}), vertices {} -> {}",
+                     total_stats.acmr_before(),
+                     total_stats.acmr_after(),
+                     mesh_optimizer::CACHE_SIZE,
+                     total_stats.vertex_count_before,
+                     total_stats.vertex_count_after);
+        std::println("\tLODs: {} indices ({:.1f}% on top of full detail), {} meshlets",
+                     lod_index_count,
+                     total_indices > 0 ? 100.0 * lod_index_count / total_indices : 0.0,
+                     scene.meshlets.size());
+        std::println("\tmap {:.3f} ms, parse {:.3f} ms, decode {:.3f} ms ({} threads), instances {:.3f} ms",
+                     map_ms,
+                     parse_ms,
+                     decode_ms,
+                     thread_pool.get_thread_count(),
+                     instance_ms);
+        return scene;
+    }
+} // namespace loader
@@ -0,0 +1,137 @@
+#include "StagingRing.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+void StagingRing::init(VkDevice device,
+                       VmaAllocator allocator,
+                       VkDeviceSize partition_size,
+                       VkDeviceSize frame_region_size,
+                       uint32_t partition_count)
+{
+    assert(frame_region_size <= partition_size);
+    m_device = device;
+    m_allocator = allocator;
+    m_partition_size = partition_size;
+    m_frame_region_size = frame_region_size;
+    m_partitions.assign(partition_count, { .frame_head = 0, .upload_head = frame_region_size });
+    m_current_partition = 0;
+
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.pNext = nullptr;
+    buffer_info.size = partition_size * partition_count;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+    VmaAllocationCreateInfo vma_alloc_info = {};
+    vma_alloc_info.usage = VMA_MEMORY_USAGE_AUTO;
+    vma_alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+
+    VK_CHECK(vmaCreateBuffer(
+        m_allocator, &buffer_info, &vma_alloc_info, &m_buffer.buffer, &m_buffer.allocation, &m_buffer.info));
+
+    VkMemoryPropertyFlags memory_flags = 0;
+    vmaGetAllocationMemoryProperties(m_allocator, m_buffer.allocation, &memory_flags);
+    m_coherent = (memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+    VkBufferDeviceAddressInfo address_info = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+                                               .buffer = m_buffer.buffer };
+    m_device_address = vkGetBufferDeviceAddress(m_device, &address_info);
+}
+
+void StagingRing::destroy()
+{
+    vmaDestroyBuffer(m_allocator, m_buffer.buffer, m_buffer.allocation);
+    m_buffer = {};
+    m_partitions.clear();
+}
+
+void StagingRing::begin_frame(uint32_t frame_slot, uint64_t completed_upload_value)
+{
+    std::lock_guard lock(m_mutex);
+    m_current_partition = frame_slot;
+    Partition& partition = m_partitions[frame_slot];
+    // The frame's timeline value has completed, so nothing reads its frame region anymore
+    partition.frame_head = 0;
+    // An upload sourced from this partition may still be in flight on the transfer queue. Leave the upload region
+    // full in that case; uploads fall back to dedicated buffers until the next time around.
+    if (partition.open_uploads == 0 && partition.retire_upload_value <= completed_upload_value)
+    {
+        partition.upload_head = m_frame_region_size;
+    }
+}
+
+bool StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, StagingAllocation& out_allocation)
+{
+    std::lock_guard lock(m_mutex);
+    Partition& partition = m_partitions[m_current_partition];
+    return allocate_locked(partition.frame_head, m_frame_region_size, size, alignment, out_allocation);
+}
+
+bool StagingRing::allocate_for_upload(VkDeviceSize size,
+                                      VkDeviceSize alignment,
+                                      uint32_t& pinned_partitions,
+                                      StagingAllocation& out_allocation)
+{
+    std::lock_guard lock(m_mutex);
+    Partition& partition = m_partitions[m_current_partition];
+    if (!allocate_locked(partition.upload_head, m_partition_size, size, alignment, out_allocation))
+    {
+        return false;
+    }
+    if ((pinned_partitions & (1u << m_current_partition)) == 0)
+    {
+        partition.open_uploads++;
+        pinned_partitions |= 1u << m_current_partition;
+    }
+    return true;
+}
+
+bool StagingRing::allocate_locked(VkDeviceSize& head,
+                                  VkDeviceSize region_end,
+                                  VkDeviceSize size,
+                                  VkDeviceSize alignment,
+                                  StagingAllocation& out_allocation)
+{
+    alignment = std::max<VkDeviceSize>(alignment, 16);
+    const VkDeviceSize offset = (head + alignment - 1) & ~(alignment - 1);
+    if (offset + size > region_end)
+    {
+        return false;
+    }
+    head = offset + size;
+
+    const VkDeviceSize buffer_offset = m_current_partition * m_partition_size + offset;
+    out_allocation.buffer = m_buffer.buffer;
+    out_allocation.offset = buffer_offset;
+    out_allocation.size = size;
+    out_allocation.mapped = static_cast<char*>(m_buffer.info.pMappedData) + buffer_offset;
+    out_allocation.device_address = m_device_address + buffer_offset;
+    out_allocation.partition = m_current_partition;
+    return true;
+}
+
+void StagingRing::flush(const StagingAllocation& allocation)
+{
+    if (!m_coherent)
+    {
+        VK_CHECK(vmaFlushAllocation(m_allocator, m_buffer.allocation, allocation.offset, allocation.size));
+    }
+}
+
+void StagingRing::retain_for_upload(uint32_t partition, uint64_t upload_value)
+{
+    std::lock_guard lock(m_mutex);
+    assert(m_partitions[partition].open_uploads > 0);
+    m_partitions[partition].open_uploads--;
+    m_partitions[partition].retire_upload_value = std::max(m_partitions[partition].retire_upload_value, upload_value);
+}
+
+VkDeviceSize StagingRing::get_used_bytes(uint32_t partition) const
+{
+    std::lock_guard lock(m_mutex);
+    const Partition& used = m_partitions[partition];
+    return used.frame_head + (used.upload_head - m_frame_region_size);
+}
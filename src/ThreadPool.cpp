@@ -0,0 +1,53 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+void ThreadPool::init(uint32_t thread_count)
+{
+    if (thread_count == 0)
+    {
+        // Leave one core for the render loop
+        thread_count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+
+    m_stop = false;
+    m_workers.reserve(thread_count);
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        m_workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+void ThreadPool::destroy()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+void ThreadPool::worker_loop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+            // Drain remaining jobs before exiting so nobody is left waiting on a future
+            if (m_jobs.empty())
+            {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
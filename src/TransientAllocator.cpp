@@ -0,0 +1,257 @@
+#include "TransientAllocator.h"
+#include "Initializers.h"
+
+#include <algorithm>
+#include <numeric>
+#include <print>
+
+void TransientAllocator::init(VkDevice device, VmaAllocator allocator, std::vector<uint32_t> queue_families)
+{
+    m_device = device;
+    m_allocator = allocator;
+    m_queue_families = std::move(queue_families);
+}
+
+void TransientAllocator::destroy()
+{
+    release();
+    m_images.clear();
+}
+
+uint32_t TransientAllocator::add_image(const TransientImageDesc& desc)
+{
+    Image image = {};
+    image.desc = desc;
+    m_images.push_back(image);
+    return static_cast<uint32_t>(m_images.size() - 1);
+}
+
+void TransientAllocator::set_extent(uint32_t image, VkExtent3D extent)
+{
+    m_images[image].desc.extent = extent;
+}
+
+void TransientAllocator::set_lifetime(uint32_t image, uint32_t first_pass, uint32_t last_pass)
+{
+    m_images[image].first_pass = first_pass;
+    m_images[image].last_pass = last_pass;
+}
+
+static bool lifetimes_overlap(uint32_t first_a, uint32_t last_a, uint32_t first_b, uint32_t last_b)
+{
+    return first_a <= last_b && first_b <= last_a;
+}
+
+std::vector<TransientAllocator::Block> TransientAllocator::place(std::vector<Placement>& out_placements) const
+{
+    std::vector<uint32_t> order(m_images.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(),
+                     order.end(),
+                     [this](uint32_t a, uint32_t b)
+                     { return m_images[a].requirements.size > m_images[b].requirements.size; });
+
+    std::vector<Block> blocks;
+    out_placements.assign(m_images.size(), {});
+    std::vector<uint32_t> placed;
+    for (const uint32_t index : order)
+    {
+        const Image& image = m_images[index];
+        const VkMemoryRequirements& requirements = image.requirements;
+
+        // Share a block with every image that can live in the same memory type
+        uint32_t block_index = 0;
+        while (block_index < blocks.size() &&
+               (blocks[block_index].memory_type_bits & requirements.memoryTypeBits) == 0)
+        {
+            block_index++;
+        }
+        if (block_index == blocks.size())
+        {
+            blocks.push_back({ requirements.memoryTypeBits, 1, 0, VK_NULL_HANDLE });
+        }
+        Block& block = blocks[block_index];
+
+        // Ranges taken by placed images in this block that are alive at the same time, sorted by offset
+        std::vector<std::pair<VkDeviceSize, VkDeviceSize>> taken;
+        for (const uint32_t other : placed)
+        {
+            const Image& other_image = m_images[other];
+            if (out_placements[other].block == block_index &&
+                lifetimes_overlap(
+                    image.first_pass, image.last_pass, other_image.first_pass, other_image.last_pass))
+            {
+                taken.emplace_back(out_placements[other].offset,
+                                   out_placements[other].offset + other_image.requirements.size);
+            }
+        }
+        std::sort(taken.begin(), taken.end());
+
+        const VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+        VkDeviceSize offset = 0;
+        for (const auto& [begin, end] : taken)
+        {
+            if (offset + requirements.size <= begin)
+            {
+                break;
+            }
+            offset = std::max(offset, (end + alignment - 1) / alignment * alignment);
+        }
+
+        block.memory_type_bits &= requirements.memoryTypeBits;
+        block.alignment = std::max(block.alignment, alignment);
+        block.size = std::max(block.size, offset + requirements.size);
+        out_placements[index] = { block_index, offset };
+        placed.push_back(index);
+    }
+    return blocks;
+}
+
+void TransientAllocator::allocate()
+{
+    m_requested_bytes = 0;
+    for (Image& image : m_images)
+    {
+        const TransientImageDesc& desc = image.desc;
+        VkImageCreateInfo image_info = init::image_create_info(desc.format, desc.usage, desc.extent);
+        if (desc.concurrent && m_queue_families.size() > 1)
+        {
+            image_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            image_info.queueFamilyIndexCount = static_cast<uint32_t>(m_queue_families.size());
+            image_info.pQueueFamilyIndices = m_queue_families.data();
+        }
+        VK_CHECK(vkCreateImage(m_device, &image_info, nullptr, &image.image.image));
+        vkGetImageMemoryRequirements(m_device, image.image.image, &image.requirements);
+        image.image.image_format = desc.format;
+        image.image.image_extent = desc.extent;
+        image.image.allocation = VK_NULL_HANDLE;
+        m_requested_bytes += image.requirements.size;
+    }
+
+    std::vector<Placement> placements;
+    m_blocks = place(placements);
+
+    VmaAllocationCreateInfo alloc_info = {};
+    alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    alloc_info.requiredFlags = static_cast<VkMemoryPropertyFlags>(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_allocated_bytes = 0;
+    for (Block& block : m_blocks)
+    {
+        const VkMemoryRequirements requirements = { block.size, block.alignment, block.memory_type_bits };
+        VK_CHECK(vmaAllocateMemory(m_allocator, &requirements, &alloc_info, &block.allocation, nullptr));
+        m_allocated_bytes += block.size;
+    }
+
+    for (size_t i = 0; i < m_images.size(); i++)
+    {
+        Image& image = m_images[i];
+        image.placement = placements[i];
+        const VmaAllocation block_allocation = m_blocks[image.placement.block].allocation;
+        VK_CHECK(
+            vmaBindImageMemory2(m_allocator, block_allocation, image.placement.offset, image.image.image, nullptr));
+
+        VkImageViewCreateInfo view_info =
+            init::image_view_create_info(image.desc.format, image.image.image, image.desc.aspect);
+        VK_CHECK(vkCreateImageView(m_device, &view_info, nullptr, &image.image.image_view));
+    }
+
+    std::println("Transient render targets: {} images in {} blocks, {:.2f} MB requested, {:.2f} MB allocated "
+                 "({:.2f} MB saved by aliasing)",
+                 m_images.size(),
+                 m_blocks.size(),
+                 m_requested_bytes / (1024.0 * 1024.0),
+                 m_allocated_bytes / (1024.0 * 1024.0),
+                 (m_requested_bytes - m_allocated_bytes) / (1024.0 * 1024.0));
+}
+
+void TransientAllocator::release()
+{
+    for (Image& image : m_images)
+    {
+        if (image.image.image == VK_NULL_HANDLE)
+        {
+            continue;
+        }
+        vkDestroyImageView(m_device, image.image.image_view, nullptr);
+        vkDestroyImage(m_device, image.image.image, nullptr);
+        image.image.image = VK_NULL_HANDLE;
+        image.image.image_view = VK_NULL_HANDLE;
+    }
+    for (Block& block : m_blocks)
+    {
+        vmaFreeMemory(m_allocator, block.allocation);
+    }
+    m_blocks.clear();
+    m_requested_bytes = 0;
+    m_allocated_bytes = 0;
+}
+
+void TransientAllocator::retire(TimelineDeletionQueue& deletion_queue)
+{
+    std::vector<AllocatedImage> images;
+    for (Image& image : m_images)
+    {
+        if (image.image.image != VK_NULL_HANDLE)
+        {
+            images.push_back(image.image);
+        }
+        image.image.image = VK_NULL_HANDLE;
+        image.image.image_view = VK_NULL_HANDLE;
+    }
+    std::vector<VmaAllocation> allocations;
+    for (const Block& block : m_blocks)
+    {
+        allocations.push_back(block.allocation);
+    }
+    deletion_queue.push_function(
+        [device = m_device, allocator = m_allocator, images = std::move(images), allocations = std::move(allocations)]()
+        {
+            for (const AllocatedImage& image : images)
+            {
+                vkDestroyImageView(device, image.image_view, nullptr);
+                vkDestroyImage(device, image.image, nullptr);
+            }
+            for (VmaAllocation allocation : allocations)
+            {
+                vmaFreeMemory(allocator, allocation);
+            }
+        });
+    m_blocks.clear();
+    m_requested_bytes = 0;
+    m_allocated_bytes = 0;
+}
+
+bool TransientAllocator::is_placement_stale() const
+{
+    if (m_blocks.empty())
+    {
+        return false;
+    }
+    std::vector<Placement> placements;
+    const std::vector<Block> blocks = place(placements);
+    if (blocks.size() != m_blocks.size())
+    {
+        return true;
+    }
+    for (size_t i = 0; i < m_images.size(); i++)
+    {
+        if (placements[i].block != m_images[i].placement.block ||
+            placements[i].offset != m_images[i].placement.offset)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TransientAllocator::aliases(uint32_t a, uint32_t b) const
+{
+    const Image& image_a = m_images[a];
+    const Image& image_b = m_images[b];
+    if (a == b || image_a.placement.block != image_b.placement.block)
+    {
+        return false;
+    }
+    return image_a.placement.offset < image_b.placement.offset + image_b.requirements.size &&
+           image_b.placement.offset < image_a.placement.offset + image_a.requirements.size;
+}
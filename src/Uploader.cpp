@@ -0,0 +1,276 @@
+#include "Uploader.h"
+#include "Initializers.h"
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+void UploadBatch::copy_to_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    Copy copy = {};
+    copy.dst = dst;
+    copy.region.dstOffset = dst_offset;
+    copy.region.size = size;
+
+    StagingAllocation allocation = {};
+    StagingRing* ring = m_uploader->m_staging_ring;
+    if (ring && ring->allocate_for_upload(size, 16, m_ring_partition_mask, allocation))
+    {
+        memcpy(allocation.mapped, data, size);
+        ring->flush(allocation);
+        copy.src = allocation.buffer;
+        copy.region.srcOffset = allocation.offset;
+    }
+    else
+    {
+        copy.dedicated_staging = m_uploader->create_staging_buffer(size);
+        memcpy(copy.dedicated_staging.info.pMappedData, data, size);
+        VK_CHECK(vmaFlushAllocation(m_uploader->m_allocator, copy.dedicated_staging.allocation, 0, size));
+        copy.src = copy.dedicated_staging.buffer;
+        copy.region.srcOffset = 0;
+    }
+    m_copies.push_back(copy);
+}
+
+void Uploader::init(VkDevice device,
+                    VmaAllocator allocator,
+                    StagingRing* staging_ring,
+                    uint32_t queue_family_index,
+                    VkQueue queue,
+                    std::mutex* queue_mutex)
+{
+    m_device = device;
+    m_allocator = allocator;
+    m_staging_ring = staging_ring;
+    m_queue_family_index = queue_family_index;
+    m_queue = queue;
+    m_queue_mutex = queue_mutex;
+
+    VkCommandPoolCreateInfo pool_info =
+        init::command_pool_create_info(m_queue_family_index, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+    VK_CHECK(vkCreateCommandPool(m_device, &pool_info, nullptr, &m_command_pool));
+
+    VkSemaphoreTypeCreateInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timeline_info.pNext = nullptr;
+    timeline_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timeline_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphore_info = init::semaphore_create_info();
+    semaphore_info.pNext = &timeline_info;
+    VK_CHECK(vkCreateSemaphore(m_device, &semaphore_info, nullptr, &m_timeline_semaphore));
+
+    m_stop = false;
+    m_worker = std::thread(&Uploader::worker_loop, this);
+}
+
+void Uploader::destroy()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_one();
+    if (m_worker.joinable())
+    {
+        m_worker.join();
+    }
+
+    vkDestroySemaphore(m_device, m_timeline_semaphore, nullptr);
+    vkDestroyCommandPool(m_device, m_command_pool, nullptr);
+}
+
+UploadBatch Uploader::begin_batch()
+{
+    UploadBatch batch;
+    batch.m_uploader = this;
+    return batch;
+}
+
+UploadTicket Uploader::submit(UploadBatch&& batch)
+{
+    PendingBatch pending = {};
+    pending.copies = std::move(batch.m_copies);
+
+    UploadTicket ticket = {};
+    ticket.completion = pending.completion.get_future().share();
+    {
+        std::lock_guard lock(m_mutex);
+        // Values are handed out under the same lock that orders the queue, so the worker signals them monotonically
+        pending.value = m_next_value++;
+        ticket.value = pending.value;
+        m_queued.push_back(std::move(pending));
+    }
+
+    for (uint32_t partition = 0; batch.m_ring_partition_mask >> partition; partition++)
+    {
+        if (batch.m_ring_partition_mask & (1u << partition))
+        {
+            m_staging_ring->retain_for_upload(partition, ticket.value);
+        }
+    }
+    batch.m_ring_partition_mask = 0;
+    m_condition.notify_one();
+    return ticket;
+}
+
+void Uploader::wait_idle()
+{
+    uint64_t last_value = 0;
+    {
+        std::unique_lock lock(m_mutex);
+        last_value = m_next_value - 1;
+    }
+    if (last_value == 0)
+    {
+        return;
+    }
+
+    while (!is_submitted(last_value))
+    {
+        std::this_thread::yield();
+    }
+
+    VkSemaphoreWaitInfo wait_info = {};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.pNext = nullptr;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &m_timeline_semaphore;
+    wait_info.pValues = &last_value;
+    VK_CHECK(vkWaitSemaphores(m_device, &wait_info, UINT64_MAX));
+}
+
+bool Uploader::is_submitted(uint64_t value) const
+{
+    return m_submitted_value.load(std::memory_order_acquire) >= value;
+}
+
+bool Uploader::is_complete(uint64_t value) const
+{
+    return get_completed_value() >= value;
+}
+
+uint64_t Uploader::get_completed_value() const
+{
+    uint64_t completed_value = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_timeline_semaphore, &completed_value));
+    return completed_value;
+}
+
+AllocatedBuffer Uploader::create_staging_buffer(VkDeviceSize size)
+{
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.pNext = nullptr;
+    buffer_info.size = size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo vma_alloc_info = {};
+    vma_alloc_info.usage = VMA_MEMORY_USAGE_AUTO;
+    vma_alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+
+    AllocatedBuffer staging = {};
+    VK_CHECK(vmaCreateBuffer(
+        m_allocator, &buffer_info, &vma_alloc_info, &staging.buffer, &staging.allocation, &staging.info));
+    return staging;
+}
+
+void Uploader::worker_loop()
+{
+    // Batches that have been submitted but whose timeline value has not been reached yet. Only touched here.
+    std::deque<PendingBatch> in_flight;
+
+    std::unique_lock lock(m_mutex);
+    while (true)
+    {
+        if (in_flight.empty())
+        {
+            m_condition.wait(lock, [this]() { return m_stop || !m_queued.empty(); });
+        }
+
+        std::deque<PendingBatch> queued = std::move(m_queued);
+        m_queued.clear();
+        const bool stopping = m_stop;
+        lock.unlock();
+
+        for (PendingBatch& batch : queued)
+        {
+            submit_batch(batch);
+            in_flight.push_back(std::move(batch));
+        }
+
+        // Retire in order. While nothing new is queued, block briefly on the oldest batch instead of spinning.
+        while (!in_flight.empty())
+        {
+            uint64_t wait_value = in_flight.front().value;
+            VkSemaphoreWaitInfo wait_info = {};
+            wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            wait_info.pNext = nullptr;
+            wait_info.semaphoreCount = 1;
+            wait_info.pSemaphores = &m_timeline_semaphore;
+            wait_info.pValues = &wait_value;
+            const uint64_t timeout = stopping ? UINT64_MAX : 1'000'000; // 1ms
+            if (vkWaitSemaphores(m_device, &wait_info, timeout) != VK_SUCCESS)
+            {
+                break;
+            }
+            retire_batch(in_flight.front());
+            in_flight.pop_front();
+        }
+
+        lock.lock();
+        if (stopping && m_queued.empty() && in_flight.empty())
+        {
+            break;
+        }
+    }
+}
+
+void Uploader::submit_batch(PendingBatch& batch)
+{
+    VkCommandBufferAllocateInfo alloc_info = init::command_buffer_allocate_info(m_command_pool, 1);
+    VK_CHECK(vkAllocateCommandBuffers(m_device, &alloc_info, &batch.command_buffer));
+
+    VkCommandBufferBeginInfo begin_info = init::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(batch.command_buffer, &begin_info));
+    for (const UploadBatch::Copy& copy : batch.copies)
+    {
+        vkCmdCopyBuffer(batch.command_buffer, copy.src, copy.dst, 1, &copy.region);
+    }
+    VK_CHECK(vkEndCommandBuffer(batch.command_buffer));
+
+    VkCommandBufferSubmitInfo cmd_info = init::command_buffer_submit_info(batch.command_buffer);
+    VkSemaphoreSubmitInfo signal_info =
+        init::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, m_timeline_semaphore);
+    signal_info.value = batch.value;
+    VkSubmitInfo2 submit_info = init::submit_info(&cmd_info, &signal_info, nullptr);
+
+    if (m_queue_mutex)
+    {
+        std::lock_guard queue_lock(*m_queue_mutex);
+        VK_CHECK(vkQueueSubmit2(m_queue, 1, &submit_info, VK_NULL_HANDLE));
+    }
+    else
+    {
+        VK_CHECK(vkQueueSubmit2(m_queue, 1, &submit_info, VK_NULL_HANDLE));
+    }
+    m_submitted_value.store(batch.value, std::memory_order_release);
+}
+
+void Uploader::retire_batch(PendingBatch& batch)
+{
+    for (UploadBatch::Copy& copy : batch.copies)
+    {
+        if (copy.dedicated_staging.buffer != VK_NULL_HANDLE)
+        {
+            vmaDestroyBuffer(m_allocator, copy.dedicated_staging.buffer, copy.dedicated_staging.allocation);
+        }
+    }
+    vkFreeCommandBuffers(m_device, m_command_pool, 1, &batch.command_buffer);
+    batch.completion.set_value();
+}
@@ -1,37 +1,9 @@
 #include "Utilities.h"
-#include "Initializers.h"
 #include <fstream>
 #include <vector>
 
 namespace util
 {
-    void transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout current_layout, VkImageLayout new_layout)
-    {
-        VkImageMemoryBarrier2 image_barrier = {};
-        image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-        image_barrier.pNext = nullptr;
-        image_barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-        image_barrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
-        image_barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-        image_barrier.dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT;
-        image_barrier.oldLayout = current_layout;
-        image_barrier.newLayout = new_layout;
-
-        VkImageAspectFlags aspect_mask = (new_layout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL)
-                                             ? VK_IMAGE_ASPECT_DEPTH_BIT
-                                             : VK_IMAGE_ASPECT_COLOR_BIT;
-        image_barrier.subresourceRange = init::image_subresource_range(aspect_mask);
-        image_barrier.image = image;
-
-        VkDependencyInfo dependency_info{};
-        dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-        dependency_info.pNext = nullptr;
-        dependency_info.imageMemoryBarrierCount = 1;
-        dependency_info.pImageMemoryBarriers = &image_barrier;
-
-        vkCmdPipelineBarrier2(cmd, &dependency_info);
-    }
-
     void copy_image_to_image(
         VkCommandBuffer cmd, VkImage source, VkImage destination, VkExtent2D src_size, VkExtent2D dst_size)
     {
@@ -0,0 +1,108 @@
+#include "VertexQuantization.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace vertex_quantization
+{
+    std::vector<MeshQuantization> compute_mesh_quantization(std::span<const Vertex> vertices,
+                                                            std::span<const uint32_t> vertex_meshes,
+                                                            uint32_t mesh_count)
+    {
+        std::vector<glm::vec3> mins(mesh_count, glm::vec3(std::numeric_limits<float>::max()));
+        std::vector<glm::vec3> maxs(mesh_count, glm::vec3(std::numeric_limits<float>::lowest()));
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            const uint32_t mesh = vertex_meshes[v];
+            if (mesh >= mesh_count)
+            {
+                continue;
+            }
+            mins[mesh] = glm::min(mins[mesh], vertices[v].position);
+            maxs[mesh] = glm::max(maxs[mesh], vertices[v].position);
+        }
+
+        std::vector<MeshQuantization> meshes(mesh_count);
+        for (uint32_t mesh = 0; mesh < mesh_count; mesh++)
+        {
+            if (mins[mesh].x > maxs[mesh].x)
+            {
+                // No vertices
+                meshes[mesh] = { glm::vec4(0.0f), glm::vec4(0.0f) };
+                continue;
+            }
+            meshes[mesh] = { glm::vec4(mins[mesh], 0.0f), glm::vec4(maxs[mesh] - mins[mesh], 0.0f) };
+        }
+        return meshes;
+    }
+
+    void encode(std::span<const Vertex> vertices,
+                std::span<const uint32_t> vertex_meshes,
+                std::span<const MeshQuantization> meshes,
+                std::span<QuantizedVertex> out_vertices)
+    {
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            const Vertex& vertex = vertices[v];
+            const uint32_t mesh_index = vertex_meshes[v] < meshes.size() ? vertex_meshes[v] : 0;
+            const MeshQuantization& mesh = meshes[mesh_index];
+
+            // Flat axes (a quad's z) have no extent and decode to the offset alone
+            const glm::vec3 extent = glm::vec3(mesh.extent);
+            const glm::vec3 safe_extent = glm::max(extent, glm::vec3(std::numeric_limits<float>::min()));
+            const glm::vec3 position =
+                glm::clamp((vertex.position - glm::vec3(mesh.offset)) / safe_extent, glm::vec3(0.0f), glm::vec3(1.0f));
+            const glm::vec2 normal = encode_octahedral(vertex.normal);
+
+            QuantizedVertex& out = out_vertices[v];
+            out.position_xy = glm::packUnorm2x16(glm::vec2(position.x, position.y));
+            out.position_z_normal = (glm::packUnorm2x16(glm::vec2(position.z, 0.0f)) & 0xFFFFu) |
+                                    (glm::packSnorm4x8(glm::vec4(0.0f, 0.0f, normal.x, normal.y)) & 0xFFFF0000u);
+            out.uv = glm::packHalf2x16(glm::vec2(vertex.uv_x, vertex.uv_y));
+            out.color = glm::packUnorm4x8(vertex.color);
+        }
+    }
+
+    Vertex decode(const QuantizedVertex& vertex, const MeshQuantization& mesh)
+    {
+        const glm::vec2 position_xy = glm::unpackUnorm2x16(vertex.position_xy);
+        const glm::vec2 position_z = glm::unpackUnorm2x16(vertex.position_z_normal);
+        const glm::vec4 normal = glm::unpackSnorm4x8(vertex.position_z_normal);
+        const glm::vec2 uv = glm::unpackHalf2x16(vertex.uv);
+
+        Vertex out = {};
+        out.position =
+            glm::vec3(mesh.offset) + glm::vec3(position_xy.x, position_xy.y, position_z.x) * glm::vec3(mesh.extent);
+        out.normal = decode_octahedral(glm::vec2(normal.z, normal.w));
+        out.uv_x = uv.x;
+        out.uv_y = uv.y;
+        out.color = glm::unpackUnorm4x8(vertex.color);
+        return out;
+    }
+
+    glm::vec2 encode_octahedral(glm::vec3 normal)
+    {
+        const float length = glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+        if (length == 0.0f)
+        {
+            return glm::vec2(0.0f);
+        }
+        glm::vec2 encoded = glm::vec2(normal.x, normal.y) / length;
+        if (normal.z < 0.0f)
+        {
+            // Fold the lower hemisphere over the diagonals
+            const glm::vec2 sign = glm::vec2(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+            encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * sign;
+        }
+        return encoded;
+    }
+
+    glm::vec3 decode_octahedral(glm::vec2 encoded)
+    {
+        glm::vec3 normal = glm::vec3(encoded.x, encoded.y, 1.0f - glm::abs(encoded.x) - glm::abs(encoded.y));
+        const float fold = glm::max(-normal.z, 0.0f);
+        normal.x += normal.x >= 0.0f ? -fold : fold;
+        normal.y += normal.y >= 0.0f ? -fold : fold;
+        return glm::normalize(normal);
+    }
+} // namespace vertex_quantization
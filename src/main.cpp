@@ -1,9 +1,81 @@
 #include "Renderer.h"
+#include "MeshCache.h"
 
-int main()
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char** argv)
 {
+    if (argc > 1 && strcmp(argv[1], "--cook") == 0)
+    {
+        // Offline cook: Bikeage --cook <scene.gltf|glb> [out.bkmesh]
+        if (argc < 3)
+        {
+            std::cerr << "Usage: " << argv[0] << " --cook <scene.gltf|glb> [out.bkmesh]" << std::endl;
+            return 1;
+        }
+        const std::filesystem::path source_path = argv[2];
+        const std::filesystem::path cooked_path = argc > 3 ? argv[3] : mesh_cache::cooked_path_for(source_path);
+
+        ThreadPool thread_pool;
+        thread_pool.init();
+        const bool cooked = mesh_cache::cook(source_path, cooked_path, thread_pool);
+        thread_pool.destroy();
+        return cooked ? 0 : 1;
+    }
+
+    // Bikeage [--frames-in-flight N] [--present-mode fifo|mailbox|immediate] [--low-latency] [scene]
+    RendererSettings settings = {};
+    for (int i = 1; i < argc; i++)
+    {
+        const bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--frames-in-flight") == 0 && has_value)
+        {
+            settings.frames_in_flight = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--present-mode") == 0 && has_value)
+        {
+            const char* present_mode = argv[++i];
+            if (strcmp(present_mode, "fifo") == 0)
+            {
+                settings.present_mode = VK_PRESENT_MODE_FIFO_KHR;
+            }
+            else if (strcmp(present_mode, "mailbox") == 0)
+            {
+                settings.present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+            }
+            else if (strcmp(present_mode, "immediate") == 0)
+            {
+                settings.present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            }
+            else
+            {
+                std::cerr << "Unknown present mode " << present_mode << ", expected fifo, mailbox or immediate"
+                          << std::endl;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--low-latency") == 0)
+        {
+            settings.low_latency = true;
+        }
+        else if (argv[i][0] != '-')
+        {
+            // Optional .gltf/.glb scene, or a cooked .bkmesh, to load
+            settings.scene_path = argv[i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--frames-in-flight N] [--present-mode fifo|mailbox|immediate] [--low-latency] [scene]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
     Renderer renderer;
-    renderer.init();
+    renderer.init(settings);
     renderer.run();
     renderer.destroy();
     return 0;
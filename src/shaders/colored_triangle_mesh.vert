@@ -16,8 +16,17 @@ layout(buffer_reference, std430) readonly buffer VertexBuffer {
   Vertex vertices[];
 };
 
+// Top three rows of an affine model matrix, see GPUInstanceTransform
+struct InstanceTransform {
+  vec4 rows[3];
+};
+
 layout(buffer_reference, std430) readonly buffer InstanceTransformBuffer {
-  mat4 transforms[];
+  InstanceTransform transforms[];
+};
+
+layout(buffer_reference, std430) readonly buffer VisibleInstanceBuffer {
+  uint visible[];
 };
 
 //push constants block
@@ -26,6 +35,7 @@ layout(push_constant) uniform constants
   mat4 render_matrix;
   VertexBuffer vertexBuffer;
   InstanceTransformBuffer transformBuffer;
+  VisibleInstanceBuffer visibleBuffer;
 } PushConstants;
 
 void main()
@@ -33,11 +43,14 @@ void main()
   // Load vertex data from device adress
   Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
 
-  // Per-instance model transform
-  mat4 model = PushConstants.transformBuffer.transforms[gl_InstanceIndex];
+  // Per-instance model transform, through the cull pass's visible list
+  uint instance = PushConstants.visibleBuffer.visible[gl_InstanceIndex];
+  InstanceTransform model = PushConstants.transformBuffer.transforms[instance];
+  vec4 position = vec4(v.position, 1.0);
+  vec3 world = vec3(dot(model.rows[0], position), dot(model.rows[1], position), dot(model.rows[2], position));
 
   // Final position
-  gl_Position = PushConstants.render_matrix * model * vec4(v.position, 1.0);
+  gl_Position = PushConstants.render_matrix * vec4(world, 1.0);
 
   outColor = v.color.xyz;
   outUV.x = v.uv_x;
@@ -0,0 +1,72 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+
+layout(location = 0) out vec3 outColor;
+layout(location = 1) out vec2 outUV;
+
+// QuantizedVertex: unorm16 position relative to the mesh bounds, octahedral snorm8 normal in the upper half of the
+// second word, half-float UV and RGBA8 color
+struct QuantizedVertex {
+  uint position_xy;
+  uint position_z_normal;
+  uint uv;
+  uint color;
+};
+
+struct MeshQuantization {
+  vec4 offset;
+  vec4 extent;
+};
+
+// Top three rows of an affine model matrix, see GPUInstanceTransform
+struct InstanceTransform {
+  vec4 rows[3];
+};
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer {
+  QuantizedVertex vertices[];
+};
+
+layout(buffer_reference, std430) readonly buffer InstanceTransformBuffer {
+  InstanceTransform transforms[];
+};
+
+layout(buffer_reference, std430) readonly buffer UintBuffer {
+  uint values[];
+};
+
+layout(buffer_reference, std430) readonly buffer MeshQuantizationBuffer {
+  MeshQuantization meshes[];
+};
+
+//push constants block, GPUDrawPushConstants
+layout(push_constant) uniform constants
+{
+  mat4 render_matrix;
+  VertexBuffer vertexBuffer;
+  InstanceTransformBuffer transformBuffer;
+  UintBuffer visibleBuffer;
+  MeshQuantizationBuffer meshQuantizationBuffer;
+  UintBuffer instanceMeshBuffer;
+} PushConstants;
+
+void main()
+{
+  QuantizedVertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
+
+  // Per-instance model transform and mesh bounds, through the cull pass's visible list
+  uint instance = PushConstants.visibleBuffer.values[gl_InstanceIndex];
+  InstanceTransform model = PushConstants.transformBuffer.transforms[instance];
+  uint mesh_index = PushConstants.instanceMeshBuffer.values[instance];
+  MeshQuantization mesh = PushConstants.meshQuantizationBuffer.meshes[mesh_index];
+
+  vec3 unorm_position = vec3(unpackUnorm2x16(v.position_xy), unpackUnorm2x16(v.position_z_normal).x);
+  vec4 position = vec4(mesh.offset.xyz + unorm_position * mesh.extent.xyz, 1.0);
+  vec3 world = vec3(dot(model.rows[0], position), dot(model.rows[1], position), dot(model.rows[2], position));
+
+  // Final position
+  gl_Position = PushConstants.render_matrix * vec4(world, 1.0);
+
+  outColor = unpackUnorm4x8(v.color).xyz;
+  outUV = unpackHalf2x16(v.uv);
+}